@@ -0,0 +1,184 @@
+/*
+  Software CSMA, see EBYTE_CSMA.h
+*/
+
+#include "EBYTE_CSMA.h"
+#include "EBYTE_DutyCycle.h"
+
+/*
+create the MAC, the frame buffer is owned by the EBYTECsma template
+*/
+EBYTECsmaBase::EBYTECsmaBase(EBYTE *radio, uint8_t *frame, uint8_t maxFrame) {
+	_radio		= radio;
+	_frame		= frame;
+	_maxFrame	= maxFrame;
+}
+
+bool EBYTECsmaBase::Send(const void *data, uint8_t len) {
+
+	if ((len == 0) || (len > _maxFrame) || (len > _radio->GetSubPacketBytes()) || (_len != 0)) {
+		return false;
+	}
+	memcpy(_frame, data, len);
+	_len		= len;
+	_attempts	= 0;
+	return true;
+}
+
+bool EBYTECsmaBase::Pending() {
+	return _len != 0;
+}
+
+CSMA_STATE EBYTECsmaBase::State() {
+	return _state;
+}
+
+void EBYTECsmaBase::SetThreshold(int16_t dBm) {
+	_threshold = dBm;
+}
+
+void EBYTECsmaBase::SetBackoff(uint8_t minBE, uint8_t maxBE) {
+	_minBE	= minBE;
+	_maxBE	= (maxBE < minBE) ? minBE : maxBE;
+	_be		= _minBE;
+}
+
+uint8_t EBYTECsmaBase::BackoffExponent() {
+	return _be;
+}
+
+void EBYTECsmaBase::Collision() {
+	Collisions++;
+	if (_be < _maxBE) {
+		_be++;
+	}
+}
+
+/*
+method to back off after a busy channel, or give up on the frame
+*/
+void EBYTECsmaBase::Busy() {
+
+	ChannelBusy++;
+
+	if (++_attempts >= MaxAttempts) {
+		Dropped++;
+		_len	= 0;
+		_state	= CSMA_IDLE;
+		return;
+	}
+	if (_be < _maxBE) {
+		_be++;
+	}
+
+	// 1 to 2^BE slots of one full sub packet on air
+	_wait	= (uint32_t)random(1, (1L << _be) + 1) * _radio->AirTimeMicros(_radio->GetSubPacketBytes());
+	_since	= micros();
+	_state	= CSMA_BACKOFF;
+	Deferrals++;
+}
+
+/*
+method to wait for the duty cycle budget to have room for the frame, or a slot when the port took
+nothing for another reason. Not a busy channel: attempts and BE are left alone
+*/
+void EBYTECsmaBase::Defer() {
+
+	EBYTEDutyCycle	*budget = _radio->GetDutyCycle();
+	uint32_t		ms		= budget ? budget->WaitMillis(_radio->AirTimeMicros(_len)) : 0;
+
+	if (ms == EBYTE_DUTY_NEVER) {
+		Dropped++;
+		_len	= 0;
+		_state	= CSMA_IDLE;
+		return;
+	}
+	// micros() wraps after 71 minutes, longer waits are taken an hour at a time
+	if (ms > 3600000UL) {
+		ms = 3600000UL;
+	}
+	if (ms) {
+		_wait = (ms + 1) * 1000UL;
+		BudgetDeferrals++;
+	}
+	else {
+		_wait = _radio->AirTimeMicros(_radio->GetSubPacketBytes());
+	}
+	_since	= micros();
+	_state	= CSMA_BACKOFF;
+}
+
+void EBYTECsmaBase::Transmit() {
+
+	// a frame written in part is in the module and charged, written again it would go out twice
+	if (_radio->SendBytes(_frame, _len) == 0) {
+		Defer();
+		return;
+	}
+
+	// the module is done when its UART time and airtime have passed and AUX is back up
+	_wait	= _radio->UARTTimeMicros(_len) + _radio->AirTimeMicros(_len);
+	_since	= micros();
+	_state	= CSMA_SENDING;
+	Sent++;
+}
+
+bool EBYTECsmaBase::Poll() {
+
+	bool aux = (_radio->GetAuxPin() == -1) || _radio->GetAux();
+
+	switch (_state) {
+
+	case CSMA_IDLE:
+		if (_len == 0) {
+			return false;
+		}
+		// receiving, or a packet waiting to be read: the channel is in use
+		if (_radio->available() || !aux) {
+			Busy();
+		}
+		else if (_radio->RequestRSSI()) {
+			_state = CSMA_SENSE;
+		}
+		else {
+			// no ambient RSSI, idle AUX and nothing waiting is all there is to go on
+			Transmit();
+		}
+		break;
+
+	case CSMA_SENSE:
+		if (!_radio->PollRSSI()) {
+			break;
+		}
+		// no answer means a packet got in first
+		if (!_radio->newRSSIdataAvailable || (_radio->CalculateChannelNoiseIn_dBm(_radio->RSSIdata) > _threshold)) {
+			Busy();
+		}
+		else {
+			Transmit();
+		}
+		break;
+
+	case CSMA_BACKOFF:
+		if ((uint32_t)(micros() - _since) >= _wait) {
+			_state = CSMA_IDLE;
+		}
+		break;
+
+	case CSMA_SENDING:
+		if (((uint32_t)(micros() - _since) < _wait) || !aux) {
+			break;
+		}
+		// the module can't receive while it sends, a packet straight after means it overlapped ours
+		if (_radio->available()) {
+			Collisions++;
+		}
+		else if (_be > _minBE) {
+			_be--;
+		}
+		_len	= 0;
+		_state	= CSMA_IDLE;
+		break;
+	}
+	return _len != 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+/*
+  Software CSMA: listen before talk with backoff and contention statistics
+
+  The module's own LBT (SetEnableLBT) defers silently and never gives up. Here the sender asks the
+  module for the ambient RSSI (RequestRSSI/PollRSSI, no waiting) before each frame. If the channel is
+  above the threshold it backs off a random number of slots, one slot being the airtime of a full sub
+  packet, up to 2^BE slots. BE (the backoff exponent) goes up each time the channel is found busy and
+  back down after each frame sent, so the backoff follows how crowded the channel is. After MaxAttempts
+  busy readings the frame is dropped.
+
+  A frame the duty cycle budget refuses (DUTY_REJECT) waits until the budget has room for it, without
+  counting as a busy reading or raising BE: the channel had nothing to do with it.
+
+  Without ambient RSSI (SetRSSIAmbientNoiseEnable(true) and SaveParameters) the channel counts as busy
+  while a packet is being received (AUX low or data waiting).
+
+  Collisions can only be suspected, the module cannot listen while it sends: a packet arriving while
+  our frame was going out means someone else sent at the same time. Protocols with acknowledgements
+  should call Collision() when one does not come, which also raises BE.
+
+  Usage
+	EBYTECsma<> Mac(&Transceiver);
+	setup():	Mac.SetThreshold(-90);
+	loop():		Mac.Poll();
+				if (!Mac.Pending()) Mac.Send(&MyData, sizeof(MyData));
+
+  Read received packets before calling Poll(), the channel counts as busy while one is waiting
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_CSMA_THRESHOLD	-90			// dBm of ambient noise above which the channel is busy
+#define EBYTE_CSMA_MIN_BE		0
+#define EBYTE_CSMA_MAX_BE		5
+#define EBYTE_CSMA_ATTEMPTS		8
+
+enum CSMA_STATE {
+	CSMA_IDLE		= 0,
+	CSMA_SENSE		= 1,		// RSSI asked for
+	CSMA_BACKOFF	= 2,
+	CSMA_SENDING	= 3			// frame written, waiting for it to go out
+};
+
+class EBYTECsmaBase {
+
+public:
+
+	// method to queue a frame, false if it is too long or one is already queued
+	bool		Send(const void *data, uint8_t len);
+
+	// method to move the frame on, call as often as possible. Returns true while a frame is queued
+	bool		Poll();
+
+	bool		Pending();
+	CSMA_STATE	State();
+
+	void		SetThreshold(int16_t dBm);
+	void		SetBackoff(uint8_t minBE, uint8_t maxBE);
+
+	// method to report a frame that was not acknowledged
+	void		Collision();
+
+	// the backoff exponent now
+	uint8_t		BackoffExponent();
+
+	uint8_t		MaxAttempts		= EBYTE_CSMA_ATTEMPTS;
+
+	uint32_t	Sent			= 0;		// frames written
+	uint32_t	ChannelBusy		= 0;		// busy readings
+	uint32_t	Deferrals		= 0;		// backoffs
+	uint32_t	Dropped			= 0;		// frames given up after MaxAttempts, or too long for the budget
+	uint32_t	BudgetDeferrals	= 0;		// waits for the duty cycle budget
+	uint32_t	Collisions		= 0;		// suspected, plus those reported by Collision()
+
+protected:
+
+	EBYTECsmaBase(EBYTE *radio, uint8_t *frame, uint8_t maxFrame);
+
+private:
+
+	void		Busy();
+	void		Defer();
+	void		Transmit();
+
+	EBYTE			*_radio;
+	uint8_t			*_frame;
+	uint8_t			_maxFrame;
+	uint8_t			_len		= 0;
+	uint8_t			_attempts	= 0;
+	uint8_t			_be			= EBYTE_CSMA_MIN_BE;
+	uint8_t			_minBE		= EBYTE_CSMA_MIN_BE;
+	uint8_t			_maxBE		= EBYTE_CSMA_MAX_BE;
+	int16_t			_threshold	= EBYTE_CSMA_THRESHOLD;
+	CSMA_STATE		_state		= CSMA_IDLE;
+	uint32_t		_since		= 0;		// micros() the state started
+	uint32_t		_wait		= 0;		// us of backoff, or of the write to go out
+
+};
+
+template <uint8_t MaxFrame = 200>
+class EBYTECsma : public EBYTECsmaBase {
+
+public:
+
+	EBYTECsma(EBYTE *radio) : EBYTECsmaBase(radio, _frameData, MaxFrame) {}
+
+private:
+
+	uint8_t _frameData[MaxFrame];
+
+};
@@ -0,0 +1,233 @@
+/*
+  UART capture, see EBYTE_Capture.h
+*/
+
+#include "EBYTE_Capture.h"
+
+// AUX edges, written by the interrupt and logged at the next call
+static uint8_t				captureM0Pin	= 255;
+static uint8_t				captureM1Pin	= 255;
+static uint8_t				captureAuxPin	= 255;
+static volatile uint32_t	edgeAt[EBYTE_CAPTURE_EDGES];
+static volatile uint8_t		edgeLevels[EBYTE_CAPTURE_EDGES];		// M0, M1, AUX after the edge, as in a PINS tag
+static volatile uint8_t		edgeCount		= 0;
+
+/*
+M0 and M1 are read with AUX: a SetMode() the edge answers is then logged no later than the edge
+*/
+static void AuxEdge() {
+
+	uint8_t levels;
+
+	if (edgeCount < EBYTE_CAPTURE_EDGES) {
+		edgeAt[edgeCount] = micros();
+		levels	= ((captureM0Pin == 255) || digitalReadFast(captureM0Pin)) ? 0x01 : 0;
+		levels	|= ((captureM1Pin == 255) || digitalReadFast(captureM1Pin)) ? 0x02 : 0;
+		levels	|= digitalReadFast(captureAuxPin) ? 0x04 : 0;
+		edgeLevels[edgeCount] = levels;
+		edgeCount++;
+	}
+}
+
+/*
+create the capture, the buffer for bytes seen but not yet read is owned by the EBYTECapture template
+*/
+EBYTECaptureBase::EBYTECaptureBase(Stream *s, uint8_t PIN_M0, uint8_t PIN_M1, uint8_t PIN_AUX, uint8_t *buffer, uint8_t size) {
+	_s		= s;
+	_M0		= PIN_M0;
+	_M1		= PIN_M1;
+	_AUX	= PIN_AUX;
+	_buffer	= buffer;
+	_size	= size;
+}
+
+void EBYTECaptureBase::Begin(Print *log) {
+
+	uint8_t header[EBYTE_CAPTURE_HEADER] = { 'E', 'B', 'Y', 'C', EBYTE_CAPTURE_VERSION, _M0, _M1, _AUX };
+
+	_log		= log;
+	_last		= micros();
+	LogBytes	+= _log->write(header, sizeof(header));
+
+	// an impossible level, so the levels now are logged
+	_levels		= 0xFF;
+	Pins();
+
+	if (_AUX != 255) {
+		captureM0Pin	= _M0;
+		captureM1Pin	= _M1;
+		captureAuxPin	= _AUX;
+		edgeCount		= 0;
+		attachInterrupt(digitalPinToInterrupt(_AUX), AuxEdge, CHANGE);
+	}
+}
+
+void EBYTECaptureBase::End() {
+
+	if (_log && (_AUX != 255)) {
+		detachInterrupt(digitalPinToInterrupt(_AUX));
+	}
+	_log = nullptr;
+}
+
+void EBYTECaptureBase::Poll() {
+	Pull();
+}
+
+/*
+method to log the AUX edges the interrupt caught, at the times they happened, then the pin levels if
+they changed since. A pin that isn't there reads HIGH
+*/
+void EBYTECaptureBase::Pins() {
+
+	uint32_t	at[EBYTE_CAPTURE_EDGES];
+	uint8_t		seen[EBYTE_CAPTURE_EDGES];
+	uint8_t		edges;
+	uint8_t		levels;
+
+	if (!_log) {
+		return;
+	}
+
+	noInterrupts();
+	edges	= edgeCount;
+	for (uint8_t i = 0; i < edges; i++) {
+		at[i]	= edgeAt[i];
+		seen[i]	= edgeLevels[i];
+	}
+	edgeCount = 0;
+	interrupts();
+
+	for (uint8_t i = 0; i < edges; i++) {
+		if (seen[i] != _levels) {
+			_levels = seen[i];
+			Record(EBYTE_CAPTURE_PINS | _levels, nullptr, 0, at[i]);
+			Transitions++;
+		}
+	}
+
+	levels	= ((_M0 == 255) || digitalRead(_M0)) ? 0x01 : 0;
+	levels	|= ((_M1 == 255) || digitalRead(_M1)) ? 0x02 : 0;
+	levels	|= ((_AUX == 255) || digitalRead(_AUX)) ? 0x04 : 0;
+
+	if (levels != _levels) {
+		_levels = levels;
+		Record(EBYTE_CAPTURE_PINS | levels, nullptr, 0, micros());
+		Transitions++;
+	}
+}
+
+/*
+method to move what the port has into the buffer, logging it as it comes
+*/
+void EBYTECaptureBase::Pull() {
+
+	uint8_t run[EBYTE_CAPTURE_MAX_RUN];
+	uint8_t len = 0;
+
+	Pins();
+
+	while ((_count < _size) && (_s->available() > 0)) {
+
+		int c = _s->read();
+
+		if (c < 0) {
+			break;
+		}
+		_buffer[(_head + _count) % _size] = (uint8_t)c;
+		_count++;
+		BytesIn++;
+
+		run[len++] = (uint8_t)c;
+		if (len == sizeof(run)) {
+			Record(EBYTE_CAPTURE_RX, run, len, micros());
+			len = 0;
+		}
+	}
+	if (len) {
+		Record(EBYTE_CAPTURE_RX, run, len, micros());
+	}
+}
+
+/*
+method to write one record: tag, microseconds since the last one, data. An edge caught while the
+record before it was being written is logged at the time of that record
+*/
+void EBYTECaptureBase::Record(uint8_t tag, const uint8_t *data, uint8_t len, uint32_t at) {
+
+	uint8_t		record[6 + EBYTE_CAPTURE_MAX_RUN];
+	uint8_t		n		= 0;
+	uint32_t	delta	= at - _last;
+
+	if (!_log) {
+		return;
+	}
+	if ((int32_t)delta < 0) {
+		delta = 0;
+	}
+	_last += delta;
+
+	if (len) {
+		tag |= (len - 1);
+	}
+	record[n++] = tag;
+	do {
+		record[n] = delta & 0x7F;
+		delta >>= 7;
+		if (delta) {
+			record[n] |= 0x80;
+		}
+		n++;
+	} while (delta);
+
+	memcpy(&record[n], data, len);
+	LogBytes += _log->write(record, n + len);
+}
+
+int EBYTECaptureBase::available() {
+	Pull();
+	return _count;
+}
+
+int EBYTECaptureBase::read() {
+
+	uint8_t c;
+
+	Pull();
+	if (_count == 0) {
+		return -1;
+	}
+	c		= _buffer[_head];
+	_head	= (_head + 1) % _size;
+	_count--;
+	return c;
+}
+
+int EBYTECaptureBase::peek() {
+
+	Pull();
+	return _count ? _buffer[_head] : -1;
+}
+
+size_t EBYTECaptureBase::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t EBYTECaptureBase::write(const uint8_t *buffer, size_t size) {
+
+	size_t n;
+
+	Pins();
+	n = _s->write(buffer, size);
+	BytesOut += n;
+
+	for (size_t done = 0; done < n; done += EBYTE_CAPTURE_MAX_RUN) {
+		Record(EBYTE_CAPTURE_TX, buffer + done, ((n - done) < EBYTE_CAPTURE_MAX_RUN) ? (n - done) : EBYTE_CAPTURE_MAX_RUN, micros());
+	}
+	return n;
+}
+
+void EBYTECaptureBase::flush() {
+	_s->flush();
+	Pins();
+}
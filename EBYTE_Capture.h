@@ -0,0 +1,113 @@
+#pragma once
+/*
+  UART capture: recording what goes between the MCU and the module
+
+  EBYTECapture sits between EBYTE and the module's serial port and logs, with microsecond times, every
+  byte read from the module, every byte written to it and every change of the M0, M1 and AUX levels.
+  The log is written to any Print (an SD card file, a second serial port) and can be fed back into
+  EBYTE with EBYTEReplay (extras/linux), on a virtual clock, to reproduce a field problem or to time
+  the library against real module timing.
+
+  Bytes from the module are logged when the program first sees them: available(), read() and peek()
+  move everything the port has into the capture's buffer and log it as one record, so a replay makes
+  the same bytes available at the same time. AUX edges are caught with attachInterrupt, so those
+  inside the library's wait loops are logged at the time they happened, with the M0 and M1 levels
+  read at the edge: a mode change is logged no later than the AUX edge it causes. M0 and M1 only
+  change in SetMode(); they are also looked at on every call and in Poll() and logged when a change
+  is seen.
+
+  Usage
+	EBYTECapture<> Capture(&Serial1, PIN_M0, PIN_M1, PIN_AUX);
+	EBYTE Transceiver(&Capture, PIN_M0, PIN_M1, PIN_AUX);
+	setup():	Serial1.begin(9600); LogFile = SD.open("radio.cap", FILE_WRITE); Capture.Begin(&LogFile);
+	loop():		Capture.Poll(); ... LogFile.flush() now and then
+
+  The stream timeout of the capture is the one readBytes uses, set it instead of the port's. Only one
+  EBYTECapture per sketch (one interrupt), and not together with EBYTETimeSync. Without an interrupt
+  capable AUX pin, AUX is looked at like M0 and M1 and pulses inside the wait loops are missed.
+
+  Log format, all little endian
+	header	"EBYC", version, M0 pin, M1 pin, AUX pin
+	record	tag, microseconds since the previous record (7 bits a byte, low first, high bit set on
+			all but the last byte), then for RX and TX records the bytes
+	tag		bits 7-6 the type (EBYTE_CAPTURE_RX, _TX, _PINS), bits 5-0 for RX and TX the number of
+			bytes less one (up to 64 a record), for PINS bit 0 M0, bit 1 M1, bit 2 AUX
+
+  A byte read in a polling loop costs about 3 bytes of log, longer reads and writes about one per
+  byte. The log is written as things happen, a slow Print (SD card) slows the program down with it.
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_CAPTURE_VERSION	1
+#define EBYTE_CAPTURE_HEADER	8
+#define EBYTE_CAPTURE_RX		0x00		// bytes the module gave
+#define EBYTE_CAPTURE_TX		0x40		// bytes written to the module
+#define EBYTE_CAPTURE_PINS		0x80		// M0, M1, AUX levels
+#define EBYTE_CAPTURE_TYPE		0xC0
+#define EBYTE_CAPTURE_MAX_RUN	64			// bytes a record
+#define EBYTE_CAPTURE_EDGES		8			// AUX edges kept between calls
+
+class EBYTECaptureBase : public Stream {
+
+public:
+
+	// method to start logging to log, writes the header and the pin levels now
+	void		Begin(Print *log);
+
+	// method to stop logging, the capture keeps passing bytes through
+	void		End();
+
+	// method to look at the pins between calls, call as often as possible
+	void		Poll();
+
+	int			available();
+	int			read();
+	int			peek();
+	size_t		write(uint8_t c);
+	size_t		write(const uint8_t *buffer, size_t size);
+	using		Print::write;
+	void		flush();
+
+	uint32_t	BytesIn		= 0;
+	uint32_t	BytesOut	= 0;
+	uint32_t	Transitions	= 0;		// pin changes logged
+	uint32_t	LogBytes	= 0;
+
+protected:
+
+	EBYTECaptureBase(Stream *s, uint8_t PIN_M0, uint8_t PIN_M1, uint8_t PIN_AUX, uint8_t *buffer, uint8_t size);
+
+private:
+
+	void		Pull();
+	void		Pins();
+	void		Record(uint8_t tag, const uint8_t *data, uint8_t len, uint32_t at);
+
+	Stream		*_s;
+	Print		*_log		= nullptr;
+	uint8_t		_M0;
+	uint8_t		_M1;
+	uint8_t		_AUX;
+	uint8_t		*_buffer;
+	uint8_t		_size;
+	uint8_t		_head		= 0;		// next byte to read
+	uint8_t		_count		= 0;
+	uint8_t		_levels		= 0;
+	uint32_t	_last		= 0;		// micros() of the last record
+
+};
+
+template <uint8_t Buffer = 64>
+class EBYTECapture : public EBYTECaptureBase {
+
+public:
+
+	EBYTECapture(Stream *s, uint8_t PIN_M0 = 4, uint8_t PIN_M1 = 5, uint8_t PIN_AUX = 6) :
+		EBYTECaptureBase(s, PIN_M0, PIN_M1, PIN_AUX, _bufferData, Buffer) {}
+
+private:
+
+	uint8_t _bufferData[Buffer];
+
+};
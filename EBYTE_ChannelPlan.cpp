@@ -0,0 +1,93 @@
+/*
+  Channel plan, see EBYTE_ChannelPlan.h
+*/
+
+#include "EBYTE_ChannelPlan.h"
+
+static uint8_t gcd(uint8_t a, uint8_t b) {
+	while (b) {
+		uint8_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+create the plan, channels past EBYTE_CHANNEL_MAX are dropped from it
+*/
+EBYTEChannelPlan::EBYTEChannelPlan(uint8_t first, uint8_t count, uint8_t spacing) {
+
+	_first		= first;
+	_spacing	= spacing ? spacing : 1;
+	_count		= count;
+
+	while ((_count > 1) && ((_first + (_count - 1) * _spacing) > EBYTE_CHANNEL_MAX)) {
+		_count--;
+	}
+	if (_count == 0) {
+		_count = 1;
+	}
+}
+
+uint8_t EBYTEChannelPlan::Channels() {
+	return _count;
+}
+
+uint8_t EBYTEChannelPlan::Channel(uint8_t i) {
+	return _first + (i % _count) * _spacing;
+}
+
+uint8_t EBYTEChannelPlan::ChannelFor(uint16_t key) {
+	return Channel(key % _count);
+}
+
+void EBYTEChannelPlan::SetHopping(uint32_t dwell, uint16_t seed) {
+
+	_dwell	= dwell;
+	_offset = seed % _count;
+	_step	= 1;
+
+	if (_count > 2) {
+		// a step from the seed that is co-prime with the count, so no channel is skipped
+		_step = 1 + ((seed >> 8) % (_count - 1));
+		while (gcd(_step, _count) != 1) {
+			_step++;
+		}
+	}
+}
+
+uint8_t EBYTEChannelPlan::HopChannel(uint32_t now) {
+
+	if (_dwell == 0) {
+		return _first;
+	}
+
+	uint32_t hop = now / _dwell;
+
+	return Channel((uint8_t)(((hop % _count) * _step + _offset) % _count));
+}
+
+uint32_t EBYTEChannelPlan::NextHop(uint32_t now) {
+	return (_dwell == 0) ? 0 : (_dwell - (now % _dwell));
+}
+
+bool EBYTEChannelPlan::Tune(EBYTE &radio, uint8_t channel) {
+
+	// GetChannel() is the register image, a SetChannel() not yet saved is in it but not in the
+	// module. SetChannelFast() checks both and skips the write only when the module is on it
+	bool change = (radio.GetModuleChannel() != channel);
+
+	if (!radio.SetChannelFast(channel)) {
+		Failures++;
+		return false;
+	}
+	if (change) {
+		Switches++;
+	}
+	return true;
+}
+
+bool EBYTEChannelPlan::Follow(EBYTE &radio, uint32_t now) {
+	return Tune(radio, HopChannel(now));
+}
@@ -0,0 +1,68 @@
+#pragma once
+/*
+  Channel plan: spreading traffic over several channels
+
+  One channel carries only so much. A plan is a set of channels agreed by every node (first channel,
+  how many, and the spacing between them so neighbouring channels don't overlap), used two ways:
+
+	partitioning	each node group or traffic class has its own channel, ChannelFor(key). A gateway
+					with one module per UART, each left on one channel, takes the traffic of all of
+					them at once, so throughput grows with the number of channels
+	hopping			everyone changes channel every dwell period in the same pseudo random order, which
+					visits every channel once per round. HopChannel(now) needs time all nodes agree
+					on, EBYTETimeSync::Micros() for example, dwell is in the same units
+
+  Tune() and Follow() change the module's channel with EBYTE::SetChannelFast(), a single TEMPORARY
+  write of the channel register, only when it is different. Read everything waiting from the module
+  before changing channel, it is lost otherwise.
+
+  Usage
+	EBYTEChannelPlan Plan(10, 8, 2);				// channels 10, 12 ... 24
+	node:		Plan.Tune(Transceiver, Plan.ChannelFor(MyGroup));
+	gateway:	for (i...) { Radio[i].SetChannel(Plan.Channel(i)); Radio[i].SaveParameters(); }
+	hopping:	Plan.SetHopping(500000, 0x1234);	// 500ms dwell on Sync.Micros()
+				loop(): Plan.Follow(Transceiver, Sync.Micros());
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_CHANNEL_MAX	80
+
+class EBYTEChannelPlan {
+
+public:
+
+	EBYTEChannelPlan(uint8_t first, uint8_t count, uint8_t spacing = 1);
+
+	uint8_t		Channels();
+	uint8_t		Channel(uint8_t i);
+
+	// partitioning: the channel for a node group, traffic class or address
+	uint8_t		ChannelFor(uint16_t key);
+
+	// hopping: dwell time and the seed every node uses, which sets the order
+	void		SetHopping(uint32_t dwell, uint16_t seed);
+
+	// the channel at shared time now, and the time left on it
+	uint8_t		HopChannel(uint32_t now);
+	uint32_t	NextHop(uint32_t now);
+
+	// method to move the module to channel if it isn't on it, false if the module didn't take it
+	bool		Tune(EBYTE &radio, uint8_t channel);
+
+	// method to keep the module on the hopping channel for now, call as often as possible
+	bool		Follow(EBYTE &radio, uint32_t now);
+
+	uint16_t	Switches	= 0;		// channel changes made
+	uint16_t	Failures	= 0;		// channel changes the module did not take
+
+private:
+
+	uint8_t		_first;
+	uint8_t		_count;
+	uint8_t		_spacing;
+	uint32_t	_dwell		= 0;
+	uint8_t		_step		= 1;		// co-prime with _count, so a round visits every channel
+	uint8_t		_offset		= 0;
+
+};
@@ -0,0 +1,93 @@
+/*
+  Receive side duplicate suppression, see EBYTE_Dedup.h
+*/
+
+#include "EBYTE_Dedup.h"
+
+/*
+create the cache, the table is owned by the EBYTEDedup template
+*/
+EBYTEDedupBase::EBYTEDedupBase(EBYTEDedupEntry *entries, uint8_t maxEntries, uint8_t seqBits) {
+	_entries	= entries;
+	_maxEntries	= maxEntries;
+	_seqBits	= seqBits;
+}
+
+void EBYTEDedupBase::SetAgeOut(unsigned long ms) {
+	_ageOut = ms;
+}
+
+void EBYTEDedupBase::Clear() {
+	_count = 0;
+}
+
+uint8_t EBYTEDedupBase::Sources() {
+	return _count;
+}
+
+void EBYTEDedupBase::Reset(EBYTEDedupEntry &e, uint16_t src, uint16_t seq) {
+	e.address	= src;
+	e.top		= seq;
+	e.map		= 1;
+	e.seen		= millis();
+}
+
+bool EBYTEDedupBase::Seen(uint16_t src, uint16_t seq) {
+
+	uint16_t	mask	= (uint16_t)((1UL << _seqBits) - 1);
+	uint8_t		i		= 0;
+
+	seq &= mask;
+
+	while ((i < _count) && (_entries[i].address != src)) {
+		i++;
+	}
+
+	if (i == _count) {
+		if (_count < _maxEntries) {
+			_count++;
+		}
+		else {
+			// full, replace the source heard longest ago
+			i = 0;
+			for (uint8_t j = 1; j < _count; j++) {
+				if ((millis() - _entries[j].seen) > (millis() - _entries[i].seen)) {
+					i = j;
+				}
+			}
+			Evicted++;
+		}
+		Reset(_entries[i], src, seq);
+		return false;
+	}
+
+	EBYTEDedupEntry &e = _entries[i];
+
+	if ((millis() - e.seen) > _ageOut) {
+		Reset(e, src, seq);
+		return false;
+	}
+
+	// distance from the top, sign extended from SeqBits so numbers wrap
+	uint16_t	raw		= (seq - e.top) & mask;
+	int16_t		ahead	= (raw & (1U << (_seqBits - 1))) ? (int16_t)(raw - (mask + 1)) : (int16_t)raw;
+
+	e.seen = millis();
+
+	if (ahead > 0) {
+		e.map	= (ahead >= EBYTE_DEDUP_WINDOW) ? 1 : ((e.map << ahead) | 1);
+		e.top	= seq;
+		return false;
+	}
+	if (-ahead >= EBYTE_DEDUP_WINDOW) {
+		Restarts++;
+		Reset(e, src, seq);
+		return false;
+	}
+	if (e.map & (1UL << -ahead)) {
+		Duplicates++;
+		return true;
+	}
+	e.map |= (1UL << -ahead);
+	return false;
+}
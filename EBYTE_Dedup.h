@@ -0,0 +1,82 @@
+#pragma once
+/*
+  Receive side duplicate suppression
+
+  Retries, relays and overlapping gateways deliver the same frame more than once. The cache keeps, per
+  source address, the highest sequence number seen and a 32 bit map of the 32 numbers below it, so
+  Seen() answers in a few instructions and late, reordered frames within the window are still
+  accepted once. Sequence numbers wrap at SeqBits bits (8 for EBYTERouter).
+
+  A source not heard for the age out time is forgotten, so a node that restarts its numbering after a
+  pause is not taken for repeats. A frame from further back than the window also counts as a restart.
+  When the table is full the source heard longest ago is replaced.
+
+  Usage (in the receive path, before the handler)
+	EBYTEDedup<16> Dedup;								// 16 sources
+	if (Dedup.Seen(Src, Seq)) return;					// repeat, already handled
+	Handle(Frame);
+
+  RAM is MaxSources * 12 bytes. EBYTERouter uses one internally
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_DEDUP_WINDOW		32
+#define EBYTE_DEDUP_AGE			60000		// ms
+
+struct EBYTEDedupEntry {
+	uint16_t		address;
+	uint16_t		top;			// highest sequence number seen
+	uint32_t		map;			// bit n set = top - n seen
+	unsigned long	seen;			// millis() last heard
+};
+
+class EBYTEDedupBase {
+
+public:
+
+	// true if the frame was seen before (and should be dropped), otherwise records it
+	bool		Seen(uint16_t src, uint16_t seq);
+
+	// ms a source is remembered after its last frame
+	void		SetAgeOut(unsigned long ms);
+
+	// method to forget every source
+	void		Clear();
+
+	uint8_t		Sources();
+
+	uint32_t	Duplicates	= 0;		// repeats dropped
+	uint16_t	Restarts	= 0;		// sources whose numbering jumped back past the window
+	uint16_t	Evicted		= 0;		// sources replaced as the table was full
+
+protected:
+
+	EBYTEDedupBase(EBYTEDedupEntry *entries, uint8_t maxEntries, uint8_t seqBits);
+
+private:
+
+	void		Reset(EBYTEDedupEntry &e, uint16_t src, uint16_t seq);
+
+	EBYTEDedupEntry		*_entries;
+	uint8_t				_maxEntries;
+	uint8_t				_count		= 0;
+	uint8_t				_seqBits;
+	unsigned long		_ageOut		= EBYTE_DEDUP_AGE;
+
+};
+
+template <uint8_t MaxSources, uint8_t SeqBits = 8>
+class EBYTEDedup : public EBYTEDedupBase {
+
+	static_assert((SeqBits >= 6) && (SeqBits <= 16), "EBYTEDedup: SeqBits must be 6 to 16, the window is 32");
+
+public:
+
+	EBYTEDedup() : EBYTEDedupBase(_entryTable, MaxSources, SeqBits) {}
+
+private:
+
+	EBYTEDedupEntry _entryTable[MaxSources];
+
+};
@@ -0,0 +1,288 @@
+#pragma once
+/*
+  Delta + varint codec for periodic telemetry
+
+  Sensors tend to send nearly the same struct every few seconds. Instead of every byte, the sender
+  sends the difference to the previous frame it sent to that peer. The frame is split into 4 byte
+  little endian words, each word's difference is zigzag encoded (small negative numbers stay small)
+  and written as a varint, 7 bits per byte. A counter stepping by one or an unchanged word costs one
+  byte instead of four.
+
+  Every keyInterval frames, or whenever the delta would not be smaller, a keyframe (the raw frame)
+  is sent instead. There are no acknowledgements, so a receiver that missed a frame drops deltas
+  (counted in Dropped) until the next keyframe. Keep keyInterval small on lossy links.
+
+  On air: [seq | 0x80 if keyframe] [payload length] [payload]
+
+  Works on any frame of bytes. Raw structs are only safe between MCUs that lay them out the same, an
+  EBYTESchema packed frame (EBYTE_Schema.h) is safe everywhere and usually deltas better too.
+
+  Usage (use one instance to send and another to receive)
+	EBYTEDelta<sizeof(DATA)> Tx;
+	Tx.Send(Transceiver, 0, &MyData);				// sender, peer 0
+	EBYTEDelta<sizeof(DATA)> Rx;
+	if (Rx.Get(Transceiver, 0, &MyData)) ...		// receiver
+
+  Per peer state is kept for up to Peers addresses, RAM is Peers * (FrameSize + 5) bytes. When the
+  table is full the oldest peer is replaced (it gets a keyframe next)
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_DELTA_KEYFRAME	0x80
+
+template <uint8_t FrameSize, uint8_t Peers = 1>
+class EBYTEDelta {
+
+	static_assert(FrameSize + 2 <= 200, "EBYTEDelta: frame and header must fit a 200 byte sub packet");
+
+public:
+
+	// largest encoded frame, a keyframe
+	static const uint8_t MaxEncoded = FrameSize + 2;
+
+	EBYTEDelta(uint8_t keyInterval = 16) : _keyInterval(keyInterval) {}
+
+	// method to encode a frame for a peer into out (MaxEncoded bytes), returns the encoded length
+	uint8_t Encode(uint16_t peer, const void *frame, uint8_t *out) {
+
+		Peer			*p		= Find(peer);
+		const uint8_t	*cur	= (const uint8_t *)frame;
+		uint8_t			len		= 0;
+		bool			key		= !p->valid || (p->sinceKey >= _keyInterval);
+
+		for (uint8_t i = 0; !key && (i < FrameSize); i += 4) {
+
+			uint8_t		n = ((FrameSize - i) < 4) ? (FrameSize - i) : 4;
+			uint32_t	z = ZigZag(Word(cur + i, n) - Word(p->last + i, n), n);
+
+			// a delta as large as the frame is no gain
+			if ((len + VarintSize(z)) >= FrameSize) {
+				key = true;
+			}
+			else {
+				len = PutVarint(out + 2, len, z);
+			}
+		}
+
+		if (key) {
+			memcpy(out + 2, cur, FrameSize);
+			len			= FrameSize;
+			p->sinceKey = 0;
+			Keyframes++;
+		}
+		else {
+			p->sinceKey++;
+		}
+
+		p->seq		= (p->seq + 1) & 0x7F;
+		p->valid	= true;
+		memcpy(p->last, cur, FrameSize);
+
+		out[0] = p->seq | (key ? EBYTE_DELTA_KEYFRAME : 0);
+		out[1] = len;
+
+		RawBytes	+= FrameSize;
+		CodedBytes	+= len + 2;
+
+		return len + 2;
+	}
+
+	// method to decode an encoded frame from a peer, returns false (frame untouched) if it can't be
+	// rebuilt, a delta after a lost frame for example
+	bool Decode(uint16_t peer, const uint8_t *in, uint8_t len, void *frame) {
+
+		Peer *p = Find(peer);
+
+		if ((len < 2) || (in[1] != (len - 2))) {
+			Dropped++;
+			return false;
+		}
+
+		uint8_t			seq		= in[0] & 0x7F;
+		uint8_t			size	= in[1];
+		const uint8_t	*data	= in + 2;
+
+		if (in[0] & EBYTE_DELTA_KEYFRAME) {
+			if (size != FrameSize) {
+				Dropped++;
+				return false;
+			}
+			memcpy(p->last, data, FrameSize);
+			Keyframes++;
+		}
+		else {
+			uint8_t pos = 0;
+
+			p->valid = p->valid && (seq == ((p->seq + 1) & 0x7F));
+
+			for (uint8_t i = 0; p->valid && (i < FrameSize); i += 4) {
+
+				uint8_t		n = ((FrameSize - i) < 4) ? (FrameSize - i) : 4;
+				uint32_t	z;
+
+				p->valid = GetVarint(data, size, pos, z);
+				if (p->valid) {
+					SetWord(p->last + i, n, Word(p->last + i, n) + UnZigZag(z));
+				}
+			}
+			if (!p->valid || (pos != size)) {
+				p->valid = false;
+				Dropped++;
+				return false;
+			}
+		}
+
+		p->seq		= seq;
+		p->valid	= true;
+		memcpy(frame, p->last, FrameSize);
+
+		RawBytes	+= FrameSize;
+		CodedBytes	+= len;
+
+		return true;
+	}
+
+	// methods to send and receive through the EBYTE object
+	bool Send(EBYTE &radio, uint16_t peer, const void *frame) {
+
+		uint8_t out[MaxEncoded];
+		uint8_t len = Encode(peer, frame, out);
+
+		return radio.SendStruct(out, len);
+	}
+
+	bool Get(EBYTE &radio, uint16_t peer, void *frame) {
+
+		uint8_t		in[MaxEncoded];
+		uint16_t	n = radio.GetBytes(in, 2);
+
+		// whatever is left of a frame that can't be read is dropped, or it is taken for the next header
+		if (n != 2) {
+			if (n) {
+				radio.DropPacket();
+			}
+			return false;
+		}
+		if (in[1] > FrameSize) {
+			radio.DropPacket();
+			Dropped++;
+			return false;
+		}
+		if (!radio.GetStruct(in + 2, in[1])) {
+			radio.DropPacket();
+			return false;
+		}
+
+		return Decode(peer, in, in[1] + 2, frame);
+	}
+
+	// method to force a keyframe to (or wait for a keyframe from) a peer
+	void Reset(uint16_t peer) {
+		Find(peer)->valid = false;
+	}
+
+	// raw frame bytes over bytes on air, 4.0 means a quarter of the airtime
+	float CompressionRatio() {
+		return CodedBytes ? ((float)RawBytes / (float)CodedBytes) : 1.0;
+	}
+
+	uint32_t	RawBytes	= 0;		// frame bytes encoded or decoded
+	uint32_t	CodedBytes	= 0;		// bytes on air for those frames
+	uint16_t	Keyframes	= 0;		// keyframes sent or received
+	uint16_t	Dropped		= 0;		// frames that could not be decoded
+
+private:
+
+	struct Peer {
+		uint16_t	address;
+		uint8_t		seq;
+		uint8_t		sinceKey;
+		bool		valid;
+		uint8_t		last[FrameSize];
+	};
+
+	Peer *Find(uint16_t address) {
+
+		Peer *p;
+
+		for (uint8_t i = 0; i < _used; i++) {
+			if (_peers[i].address == address) {
+				return &_peers[i];
+			}
+		}
+		if (_used < Peers) {
+			p = &_peers[_used++];
+		}
+		else {
+			p		= &_peers[_next];
+			_next	= (_next + 1) % Peers;
+		}
+		p->address	= address;
+		p->seq		= 0x7F;
+		p->sinceKey	= 0;
+		p->valid	= false;
+		return p;
+	}
+
+	// n byte little endian word, differences are taken modulo 2^(8n)
+	static uint32_t Word(const uint8_t *b, uint8_t n) {
+		uint32_t w = 0;
+		while (n--) {
+			w = (w << 8) | b[n];
+		}
+		return w;
+	}
+
+	static void SetWord(uint8_t *b, uint8_t n, uint32_t w) {
+		for (uint8_t i = 0; i < n; i++, w >>= 8) {
+			b[i] = (uint8_t)w;
+		}
+	}
+
+	static uint32_t ZigZag(uint32_t d, uint8_t n) {
+		uint8_t shift	= 32 - (8 * n);
+		int32_t s		= (int32_t)(d << shift) >> shift;		// sign extend from 8n bits
+		return ((uint32_t)s << 1) ^ (uint32_t)(s >> 31);
+	}
+
+	static uint32_t UnZigZag(uint32_t z) {
+		return (z >> 1) ^ (0 - (z & 1));
+	}
+
+	static uint8_t VarintSize(uint32_t z) {
+		uint8_t n = 1;
+		while (z >= 0x80) {
+			z >>= 7;
+			n++;
+		}
+		return n;
+	}
+
+	static uint8_t PutVarint(uint8_t *out, uint8_t pos, uint32_t z) {
+		while (z >= 0x80) {
+			out[pos++] = (uint8_t)(z | 0x80);
+			z >>= 7;
+		}
+		out[pos++] = (uint8_t)z;
+		return pos;
+	}
+
+	static bool GetVarint(const uint8_t *in, uint8_t size, uint8_t &pos, uint32_t &z) {
+		z = 0;
+		for (uint8_t shift = 0; (pos < size) && (shift < 35); shift += 7) {
+			uint8_t b = in[pos++];
+			z |= (uint32_t)(b & 0x7F) << shift;
+			if (!(b & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Peer	_peers[Peers];
+	uint8_t _used			= 0;
+	uint8_t _next			= 0;
+	uint8_t _keyInterval;
+
+};
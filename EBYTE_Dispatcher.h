@@ -0,0 +1,113 @@
+#pragma once
+/*
+  Receive side of the typed message API (see Send<T>() and EBYTE_MESSAGE in EBYTE_E220.h)
+
+  Register a handler per message type, then call Poll() from loop(). Poll() reads the type id, reads
+  the message straight into the dispatcher's buffer (no extra copy) and calls the handler with a
+  reference into that buffer. The reference is only valid until the next Poll(). Bytes after the
+  registered type (a longer packet) are dropped with DropPacket(), which waits for 5ms of silence.
+
+  Usage
+	EBYTE_MESSAGE(DATA, 1)
+	EBYTE_MESSAGE(ALARM, 2)
+
+	EBYTEDispatcher<> Dispatcher(&Transceiver);
+
+	void OnData(const DATA &d) { ... }
+	void OnAlarm(const ALARM &a) { ... }
+
+	setup():	Dispatcher.On(OnData);
+				Dispatcher.On(OnAlarm);
+	loop():		Dispatcher.Poll();
+
+  RAM used is BufferSize plus 6 bytes per handler (AVR), size BufferSize to the largest message
+*/
+
+#include "EBYTE_E220.h"
+
+template <uint8_t MaxHandlers = 8, uint8_t BufferSize = 199>
+class EBYTEDispatcher {
+
+public:
+
+	EBYTEDispatcher(EBYTE *radio) : _radio(radio) {}
+
+	// method to register the handler for a message type, false if the table is full or the id is taken
+	template <typename T>
+	bool On(void (*handler)(const T &TheMessage)) {
+
+		static_assert(__is_trivially_copyable(T), "EBYTEDispatcher: T must be trivially copyable");
+		static_assert(sizeof(T) <= BufferSize, "EBYTEDispatcher: T is larger than the dispatcher buffer");
+
+		uint8_t id = EBYTEMessageId<T>::value;
+
+		if (_count >= MaxHandlers) {
+			return false;
+		}
+		for (uint8_t i = 0; i < _count; i++) {
+			if (_entries[i].id == id) {
+				return false;
+			}
+		}
+		_entries[_count].id			= id;
+		_entries[_count].size		= sizeof(T);
+		_entries[_count].handler	= reinterpret_cast<void (*)()>(handler);
+		_entries[_count].invoke		= &Invoke<T>;
+		_count++;
+		return true;
+	}
+
+	// method to receive and dispatch one message, returns true if a handler was called
+	bool Poll() {
+
+		if (!_radio->available()) {
+			return false;
+		}
+
+		uint8_t id = _radio->GetByte();
+
+		for (uint8_t i = 0; i < _count; i++) {
+			if (_entries[i].id == id) {
+				if (!_radio->GetStruct(_buf, _entries[i].size)) {
+					Truncated++;
+					return false;
+				}
+				// anything past the registered type would be read as the next id
+				_radio->DropPacket();
+				_entries[i].invoke(_entries[i].handler, _buf);
+				return true;
+			}
+		}
+
+		// no handler so the length is unknown, drop the rest of the packet
+		Unknown++;
+		_radio->DropPacket();
+		return false;
+	}
+
+	uint16_t Unknown	= 0;		// packets dropped because no handler was registered for their id
+	uint16_t Truncated	= 0;		// packets shorter than their registered type
+
+private:
+
+	struct Entry {
+		uint8_t id;
+		uint8_t size;
+		void	(*handler)();
+		void	(*invoke)(void (*handler)(), const uint8_t *data);
+	};
+
+	// restores the handler's real type, one instance per registered message type
+	template <typename T>
+	static void Invoke(void (*handler)(), const uint8_t *data) {
+		reinterpret_cast<void (*)(const T &)>(handler)(*reinterpret_cast<const T *>(data));
+	}
+
+	EBYTE	*_radio;
+	Entry	_entries[MaxHandlers];
+	uint8_t _count = 0;
+
+	// aligned so the handler's reference is valid for any member type
+	alignas(8) uint8_t _buf[BufferSize];
+
+};
@@ -0,0 +1,119 @@
+/*
+  Duty cycle budget, see EBYTE_DutyCycle.h
+*/
+
+#include "EBYTE_DutyCycle.h"
+
+EBYTEDutyCycle::EBYTEDutyCycle(float percent, uint32_t windowSeconds) {
+	SetLimit(percent, windowSeconds);
+}
+
+void EBYTEDutyCycle::SetLimit(float percent, uint32_t windowSeconds) {
+
+	_window		= windowSeconds * 1000UL;
+	_allowance	= (percent / 100.0) * windowSeconds * 1000000.0;
+
+	SetBurst(_allowance / 50.0);
+}
+
+void EBYTEDutyCycle::SetBurst(uint32_t us) {
+
+	_burst = (us < _allowance) ? us : _allowance;
+
+	// burst + rate * window must not exceed the allowance, whichever window is looked at
+	_rate	= (_allowance - _burst) / _window;
+	_tokens = _burst;
+	_filled = millis();
+
+	// the reserve is a share of the burst, SetDutyCycle() may raise the burst after SetReserve()
+	_reserve = _burst * _reservePercent / 100.0;
+}
+
+uint32_t EBYTEDutyCycle::Burst() {
+	return _burst;
+}
+
+void EBYTEDutyCycle::SetReserve(float percent) {
+	_reservePercent	= percent;
+	_reserve		= _burst * percent / 100.0;
+}
+
+void EBYTEDutyCycle::SetPolicy(DUTY_POLICY policy) {
+	_policy = policy;
+}
+
+void EBYTEDutyCycle::Refill() {
+
+	unsigned long now = millis();
+
+	_tokens += (now - _filled) * _rate;
+	_filled = now;
+
+	if (_tokens > _burst) {
+		_tokens = _burst;
+	}
+}
+
+/*
+method to work out the us of airtime still missing for a frame, 0 or less if it can go
+*/
+float EBYTEDutyCycle::Needed(uint32_t airtime, bool urgent) {
+
+	Refill();
+	return (float)airtime + (urgent ? 0.0 : _reserve) - _tokens;
+}
+
+bool EBYTEDutyCycle::CanSend(uint32_t airtime, bool urgent) {
+	return Needed(airtime, urgent) <= 0.0;
+}
+
+uint32_t EBYTEDutyCycle::Remaining() {
+
+	Refill();
+	return (_tokens > _reserve) ? (uint32_t)(_tokens - _reserve) : 0;
+}
+
+uint32_t EBYTEDutyCycle::WaitMillis(uint32_t airtime, bool urgent) {
+
+	float need = Needed(airtime, urgent);
+
+	if (need <= 0.0) {
+		return 0;
+	}
+	if (((float)airtime + (urgent ? 0.0 : _reserve)) > _burst) {
+		return EBYTE_DUTY_NEVER;
+	}
+	return (uint32_t)ceil(need / _rate);
+}
+
+uint32_t EBYTEDutyCycle::EarliestSendTime(uint32_t airtime, bool urgent) {
+
+	uint32_t wait = WaitMillis(airtime, urgent);
+
+	return (wait == EBYTE_DUTY_NEVER) ? EBYTE_DUTY_NEVER : (millis() + wait);
+}
+
+bool EBYTEDutyCycle::Spend(uint32_t airtime, bool urgent) {
+
+	uint32_t wait = WaitMillis(airtime, urgent);
+
+	if (wait == EBYTE_DUTY_NEVER) {
+		Rejected++;
+		return false;
+	}
+	if (wait > 0) {
+		if (_policy == DUTY_REJECT) {
+			Rejected++;
+			return false;
+		}
+		Deferred++;
+		delay(wait);
+		Refill();
+	}
+
+	_tokens			-= airtime;
+	_airRemainder	+= airtime;
+	AirUsed			+= _airRemainder / 1000;
+	_airRemainder	%= 1000;
+	return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+/*
+  Duty cycle budget (EU 868MHz bands: 0.1%, 1% or 10% of any hour on air)
+
+  A token bucket of airtime. It fills at the allowed rate, every frame is charged its time on air from
+  the air data rate, sub packet size and length (EBYTE::AirTimeMicros), and the wake up preamble of
+  each sub packet in MODE_WORtransmit. Attach it with
+  EBYTE::SetDutyCycle() and SendStruct, Send, SendBytes and SendFrame are charged automatically, once
+  per call, so a frame written in parts must go through SendFrame; when the bucket is short the
+  policy decides:
+	DUTY_DEFER		wait (delay) until the frame fits, then send it
+	DUTY_REJECT		don't send, the send returns false (SendBytes and SendFrame return 0)
+
+  Urgent frames (SendBytes(..., true)) may also use the reserve (SetReserve), which normal frames
+  leave alone, so alarms still get out when routine traffic has used the budget.
+
+  Over any window the bucket allows the burst plus the fill rate times the window, so the fill rate is
+  set a burst below the limit: every window of windowSeconds stays within percent, and the sustained
+  rate is the limit less burst / window. The default burst is 2% of the window's allowance (720ms of
+  airtime per hour at 1%), 98% of the limit can be used. The burst must hold the largest frame,
+  EBYTE::SetDutyCycle() raises it to one full sub packet if it is smaller.
+
+  Remaining() is the airtime that could go out now, EarliestSendTime() the millis() a frame of a given
+  airtime can go, for sleeping or scheduling instead of waiting
+
+  Usage
+	EBYTEDutyCycle Budget(1.0);					// 1% per hour
+	Transceiver.SetDutyCycle(&Budget);
+	Budget.SetPolicy(DUTY_REJECT);
+	if (!Transceiver.SendStruct(&MyData, sizeof(MyData))) { try later }
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_DUTY_WINDOW	3600		// s, the ETSI observation period
+#define EBYTE_DUTY_NEVER	0xFFFFFFFF	// WaitMillis() for a frame larger than the bucket
+
+enum DUTY_POLICY {
+	DUTY_DEFER	= 0,
+	DUTY_REJECT	= 1
+};
+
+class EBYTEDutyCycle {
+
+public:
+
+	EBYTEDutyCycle(float percent = 1.0, uint32_t windowSeconds = EBYTE_DUTY_WINDOW);
+
+	// method to change the limit, the bucket starts full
+	void		SetLimit(float percent, uint32_t windowSeconds = EBYTE_DUTY_WINDOW);
+
+	// us of airtime that may go out back to back, sets the fill rate to match
+	void		SetBurst(uint32_t us);
+	uint32_t	Burst();
+
+	// percent of the burst only urgent frames may use
+	void		SetReserve(float percent);
+
+	void		SetPolicy(DUTY_POLICY policy);
+
+	// method to charge a frame's airtime, applies the policy. True if the frame may be sent
+	bool		Spend(uint32_t airtime, bool urgent = false);
+
+	// true if a frame of airtime could go now, nothing is charged
+	bool		CanSend(uint32_t airtime, bool urgent = false);
+
+	// us of airtime that could go out now (normal frames, the reserve is not counted)
+	uint32_t	Remaining();
+
+	// ms until, or the millis() when, a frame of airtime can go
+	uint32_t	WaitMillis(uint32_t airtime, bool urgent = false);
+	uint32_t	EarliestSendTime(uint32_t airtime, bool urgent = false);
+
+	uint32_t	AirUsed		= 0;		// ms of airtime charged
+	uint16_t	Deferred	= 0;		// frames that had to wait
+	uint16_t	Rejected	= 0;		// frames refused
+
+private:
+
+	void		Refill();
+	float		Needed(uint32_t airtime, bool urgent);
+
+	float			_allowance;			// us of airtime per window
+	uint32_t		_window;			// ms
+	float			_burst;				// bucket size, us
+	float			_rate;				// us of airtime per ms
+	float			_reserve	= 0.0;	// us
+	float			_reservePercent = 0.0;	// of the burst, the reserve follows SetBurst()
+	float			_tokens;			// us
+	uint32_t		_airRemainder = 0;	// us charged not yet in AirUsed
+	unsigned long	_filled;			// millis() of the last refill
+	DUTY_POLICY		_policy		= DUTY_DEFER;
+
+};
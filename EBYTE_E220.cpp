@@ -37,8 +37,10 @@
 											 all digitalReads changed to digitalReadFast.
   1.0			12/11/2021  Bridges/Kasprzak New release for E220 module. Modified original code from Kris Kasprzak
   1.0a			12/04/2023  Bridges			 Small update to stop compiler warnings. Has no effect on performance. Affects .cpp file.
+*/
 
 #include <EBYTE_E220.h>
+#include "EBYTE_DutyCycle.h"
 #include <Stream.h>
 
 #if ARDUINO >= 100
@@ -47,7 +49,7 @@
 #include "WProgram.h"
 #endif
 
-uint32_t baudRates[]{ 1200, 2400, 4800, 9600, 19200, 34800, 57600, 115200 };
+uint32_t baudRates[]{ 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
 
 /*
 create the transciever object
@@ -79,18 +81,25 @@ bool EBYTE::init(ebyteCallbackFunc func){  //} = nullptr) {
 	pinMode(_M1, OUTPUT);
 
 	if (func) {
-		_UARTDataRate	= UDR_9600;
-		currentBaudRate = _UARTDataRate;
+		SetUARTBaudRate(UDR_9600);
+		currentBaudRate = UDR_9600;
 		ebyteAutoBaud		= true;
 		setEbyteBaud	= func;
 		setEbyteBaud(9600);
 	}
 
+	// a valid cached register image means the module need not be read in full
+	// (loaded before SetMode so the auto baud picks up the cached UART rate)
+	if (LoadCache()) {
+		SetMode(MODE_NORMAL);
+		if (ReadChannel()) {
+			return true;
+		}
+	}
+
+	// SetMode returns as soon as AUX reports the module ready, no need for a fixed delay
 	SetMode(MODE_NORMAL);
 
-	// first get the module data (must be called first for some odd reason
-	delay(100); //(**)
-	
 //	ok = ReadModelData();
 
 	if (!ok) {
@@ -124,7 +133,65 @@ Method to write a single byte...not sure how useful this really is. If you need
 more that one byte, put the data into a data structure and send it in a big chunk
 */
 void EBYTE::SendByte( uint8_t TheByte) {
-	_s->write(TheByte);
+	if (Charge(1, false)) {
+		_s->write(TheByte);
+	}
+}
+
+/*
+Method to write bytes without the CompleteTask() wait of SendStruct
+*/
+uint16_t EBYTE::SendBytes(const void *TheData, uint16_t size_, bool urgent) {
+	if (!Charge(size_, urgent)) {
+		return 0;
+	}
+	return _s->write((const uint8_t*)TheData, size_);
+}
+
+/*
+Method to write a header and its payload as one frame. Charging them separately would count the
+per packet overhead twice, and could let the header through and refuse the payload
+*/
+uint16_t EBYTE::SendFrame(const void *Header, uint16_t headerSize, const void *Payload, uint16_t payloadSize, bool urgent) {
+
+	uint16_t sent;
+
+	if (!Charge(headerSize + payloadSize, urgent)) {
+		return 0;
+	}
+	sent = _s->write((const uint8_t*)Header, headerSize);
+
+	// a payload after a header cut short would be read as part of the header
+	if (payloadSize && (sent == headerSize)) {
+		sent += _s->write((const uint8_t*)Payload, payloadSize);
+	}
+	return sent;
+}
+
+void EBYTE::SetDutyCycle(EBYTEDutyCycle *budget) {
+
+	uint32_t largest = AirTimeMicros(GetSubPacketBytes());
+
+	// a frame larger than the burst could never be sent
+	if (budget && (budget->Burst() < largest)) {
+		budget->SetBurst(largest);
+	}
+	_DutyCycle = budget;
+}
+
+EBYTEDutyCycle *EBYTE::GetDutyCycle() {
+	return _DutyCycle;
+}
+
+/*
+Method to charge len bytes of airtime to the duty cycle budget, false if they must not be sent.
+Writes in program mode are commands for the module and never go on air
+*/
+bool EBYTE::Charge(uint16_t len, bool urgent) {
+	if (!_DutyCycle || (lastModeSet == MODE_PROGRAM)) {
+		return true;
+	}
+	return _DutyCycle->Spend(AirTimeMicros(len), urgent);
 }
 
 /*
@@ -136,6 +203,28 @@ uint8_t EBYTE::GetByte() {
 	return _s->read();
 }
 
+/*
+Method to get bytes, waits up to the stream timeout for them to arrive
+*/
+uint16_t EBYTE::GetBytes(void *TheData, uint16_t size_) {
+	return _s->readBytes((uint8_t*)TheData, size_);
+}
+
+/*
+Method to drop a packet, reads until nothing has arrived for 5ms
+*/
+void EBYTE::DropPacket() {
+
+	elapsedMillis t = 0;
+
+	while (t <= 5) {
+		if (_s->available()) {
+			_s->read();
+			t = 0;
+		}
+	}
+}
+
 /*
 Method to calculate noise lever in dBm from supplied RSSI data
 */
@@ -153,11 +242,14 @@ types each handle ints floats differently
 */
 bool EBYTE::SendStruct(const void *TheStructure, uint16_t size_) {
 
-		_buf = _s->write((uint8_t *) TheStructure, size_);
+		if (!Charge(size_, false)) {
+			return false;
+		}
+		size_t sent = _s->write((uint8_t *) TheStructure, size_);
 		
 		CompleteTask(1000);
 		
-		return (_buf == size_);
+		return (sent == size_);
 
 }
 
@@ -169,13 +261,13 @@ sketches
 NOTE: of your sender and receiver MCU's are different (Teensy and Arduino) caution on the data
 types each handle ints floats differently
 */
-bool EBYTE::GetStruct(const void *TheStructure, uint16_t size_) {
+bool EBYTE::GetStruct(void *TheStructure, uint16_t size_) {
 	
-	_buf = _s->readBytes((uint8_t*)TheStructure, size_);
+	size_t got = _s->readBytes((uint8_t*)TheStructure, size_);
 
 	newRSSIdataAvailable = false;		//(**) Starts here until CompleteTask(1000)
 
-	if (_EnableRSSIByte) {
+	if (GetEnableRSSIByte()) {
 
 		elapsedMillis t = 0;
 		while ((t <= 5) && (_s->available() == 0)) {}
@@ -188,7 +280,7 @@ bool EBYTE::GetStruct(const void *TheStructure, uint16_t size_) {
 	}
 	CompleteTask(1000);
 
-	return (_buf == size_);
+	return (got == size_);
 }
 
 /*
@@ -219,6 +311,24 @@ void EBYTE::CompleteTask(unsigned long timeout) {
 	delay(20);
 }
 
+/*
+Utility method to wait until AUX is high plus the 2ms the data sheet asks for before the
+module accepts the next command. Unlike CompleteTask it returns as soon as the module is ready
+returns false on timeout
+*/
+bool EBYTE::WaitForAUX(unsigned long timeout) {
+
+	elapsedMillis t = 0;
+
+	while (digitalReadFast(_AUX) == LOW) {
+		if (t > timeout) {
+			return false;
+		}
+	}
+	delay(2);
+	return true;
+}
+
 /*
 method to set the mode (program, normal, etc.)
 */
@@ -226,9 +336,47 @@ void EBYTE::SetMode(MODE_TYPE mode) {
 	
 	// data sheet claims module needs some extra time after mode setting (2ms)
 	// most of my projects uses 10 ms, but 40ms is safer
+	// with AUX connected wait for the module instead of guessing
 
-	delay(PIN_RECOVER);
+	if (_AUX != -1) {
+		WaitForAUX(1000);
+	}
+	else {
+		delay(PIN_RECOVER);
+	}
 	
+	WritePins(mode);
+
+	// data sheet says 2ms later control is returned, let's give just a bit more time
+	// these modules can take time to activate pins
+	// with AUX connected, give the module the 2ms to pull AUX low and then wait for it to go high
+	if (_AUX != -1) {
+		delay(2);
+		WaitForAUX(4000);
+	}
+	else {
+		delay(PIN_RECOVER);
+	}
+
+	// clear out any junk
+	// added rev 5
+	// i've had some issues where after programming, the returned model is 0, and all settings appear to be corrupt
+	// i imagine the issue is due to the internal buffer full of junk, hence clearing
+	// Reset() *MAY* work but this seems better.
+	ClearBuffer();
+
+	// wait until aux pin goes back low
+	if (_AUX == -1) {
+		CompleteTask(4000);
+	}
+	lastModeSet = mode;
+}
+
+/*
+method to drive M0/M1 for the mode, and move the UART to 9600 for program mode if auto baud is on
+*/
+void EBYTE::WritePins(MODE_TYPE mode) {
+
 	if (mode == MODE_NORMAL) {
 		digitalWriteFast(_M0, LOW);   // (**) all digitalWrites set to DigiatWriteFast
 		digitalWriteFast(_M1, LOW);
@@ -244,199 +392,115 @@ void EBYTE::SetMode(MODE_TYPE mode) {
 	if (mode == MODE_PROGRAM) {
 		digitalWriteFast(_M0, HIGH);
 		digitalWriteFast(_M1, HIGH);
-		if (ebyteAutoBaud && (_UARTDataRate != UDR_9600)) {
+		if (ebyteAutoBaud && (GetUARTBaudRate() != UDR_9600)) {
 			setEbyteBaud(9600);
 			currentBaudRate = UDR_9600;
 		}
 	}
 	else {
-		if (ebyteAutoBaud && (currentBaudRate != _UARTDataRate)) {
-			setEbyteBaud( baudRates[ _UARTDataRate ] );
-			currentBaudRate = _UARTDataRate;
+		if (ebyteAutoBaud && (currentBaudRate != GetUARTBaudRate())) {
+			setEbyteBaud( baudRates[ GetUARTBaudRate() ] );
+			currentBaudRate = GetUARTBaudRate();
 		}
 	}
-
-	// data sheet says 2ms later control is returned, let's give just a bit more time
-	// these modules can take time to activate pins
-	delay(PIN_RECOVER);
-
-	// clear out any junk
-	// added rev 5
-	// i've had some issues where after programming, the returned model is 0, and all settings appear to be corrupt
-	// i imagine the issue is due to the internal buffer full of junk, hence clearing
-	// Reset() *MAY* work but this seems better.
-	ClearBuffer();
-
-
-	// wait until aux pin goes back low
-	CompleteTask(4000);
-	lastModeSet = mode;
 }
 
-//uint8_t		_lastBaudRate		= 0;
-
 /*
-method to Set/Get the high bit of the address
+method to change mode without SetMode's fixed delays, for waking the module from deep sleep and
+putting it back. The module must be idle (AUX high). With AUX connected it returns as soon as AUX
+goes back up, and GetModeLatency() has the us that took; without AUX it waits PIN_RECOVER ms
+returns false if AUX did not come back up in time
 */
-void EBYTE::SetAddressH(uint8_t val) {
-	_AddressHigh = val;
-}
-
-uint8_t EBYTE::GetAddressH() {
-	return _AddressHigh;
-}
+bool EBYTE::SetModeFast(MODE_TYPE mode) {
 
-/*
-method to Set/Get the lo bit of the address
-*/
-void EBYTE::SetAddressL(uint8_t val) {
-	_AddressLow = val;
-}
+	uint32_t	start = micros();
+	bool		ok = true;
 
-uint8_t EBYTE::GetAddressL() {
-	return _AddressLow;
-}
+	WritePins(mode);
 
-/*
-method to Set/Get the channel
-*/
-void EBYTE::SetChannel(uint8_t val) {
-	_Channel = val;
-}
-uint8_t EBYTE::GetChannel() {
-	return _Channel;
-}
+	if (_AUX != -1) {
+		// AUX drops within the 2ms the data sheet gives, and comes back up once the module is ready
+		while ((digitalReadFast(_AUX) == HIGH) && ((uint32_t)(micros() - start) < 2000)) {
+		}
+		while (digitalReadFast(_AUX) == LOW) {
+			if ((uint32_t)(micros() - start) > 1000000UL) {
+				ok = false;
+				break;
+			}
+		}
+	}
+	else {
+		delay(PIN_RECOVER);
+	}
+	_ModeLatency = micros() - start;
 
-/*
-method to Set/Get the air data rate
-*/
-void EBYTE::SetAirDataRate(uint8_t val) {
-	_AirDataRate = val;
-	BuildREG0byte();
+	ClearBuffer();
+	lastModeSet = mode;
+	return ok;
 }
 
-uint8_t EBYTE::GetAirDataRate() {
-	return _AirDataRate;
+uint32_t EBYTE::GetModeLatency() {
+	return _ModeLatency;
 }
 
-// (**) The following functions are new since E32
-/*
-method to Set/Get the sub packet size
-*/
-void EBYTE::SetSubPacketSize(uint8_t val) {
-	_SubPacketSize = val;
-	BuildREG1byte();
-};
-
-uint8_t EBYTE::GetSubPacketSize() {
-	return _SubPacketSize;
-};
-
-/*
-method to Set/Get the RSSI Ambient Noise Enable
-*/
-void EBYTE::SetRSSIAmbientNoiseEnable(bool val) {
-	_RSSIAmbNoiseEnable = val;
-	BuildREG1byte();
-};
+//uint8_t		_lastBaudRate		= 0;
 
-bool EBYTE::GetRSSIAmbientNoiseEnable() {
-	return _RSSIAmbNoiseEnable;
-};
+bool EBYTE::SetChannelFast(uint8_t val) {
 
-/*
-method to Set/Get the Enable RSSI byte
-*/
-void EBYTE::SetEnableRSSIByte(bool val) {
-	_EnableRSSIByte = val;
-	BuildREG3byte();
-};
-bool EBYTE::GetEnableRSSIByte() {
-	return _EnableRSSIByte;
-};
+	MODE_TYPE	mode = (lastModeSet == MODE_NOT_SET) ? MODE_NORMAL : lastModeSet;
+	bool		ok;
 
-/*
-method to Set/Get the Enable LBT
-*/
-void EBYTE::SetEnableLBT(bool val) {
-	_EnableLBT = val;
-	BuildREG3byte();
-};
-bool EBYTE::GetEnableLBT() {
-	return _EnableLBT;
-};
+	// inside a transaction the channel in the image is Commit()'s, and program mode is its to take
+	if (_InConfig) {
+		return false;
+	}
+	if ((val == _ModuleImage[EBYTE_REG_CHAN]) && (val == _Image[EBYTE_REG_CHAN])) {
+		return true;
+	}
 
-/*
-method to Set/Get the parity bit
-*/
-void EBYTE::SetParityBit(uint8_t val) {
-	_ParityBit = val;
-	BuildREG0byte();
-}
+	SetMode(MODE_PROGRAM);
+	ok = WriteRegisters(TEMPORARY, EBYTE_REG_CHAN, &val, 1);
+	SetMode(mode);
 
-uint8_t EBYTE::GetParityBit( ) {
-	return _ParityBit;
+	if (ok) {
+		_Image[EBYTE_REG_CHAN] = val;
+	}
+	return ok;
 }
 
-/*
-method to Set/Get Transmission Mode
-*/
-void EBYTE::SetTransmissionMode(uint8_t val) {
-	_TransmitMode = val;
-	BuildREG3byte();
-}
-uint8_t EBYTE::GetTransmissionMode( ) {
-	return _TransmitMode;
+uint32_t EBYTE::GetAirDataRateBps() {
+	static const uint32_t bps[]{ 2400, 2400, 2400, 4800, 9600, 19200, 38400, 62500 };
+	return bps[GetAirDataRate()];
 }
 
 /*
-method to Set/Get WOR Timing
+method to estimate time on air. Data goes out in sub packets, each with EBYTE_AIR_OVERHEAD bytes of
+preamble and header, at the nominal air data rate. An estimate, but good enough to pace and budget by.
+In MODE_WORtransmit each sub packet also has the wake up preamble, 500ms per step of the WOR cycle
 */
-void EBYTE::SetWORTIming(uint8_t val) {
-	_WORTiming = val;
-	BuildREG3byte();
-}
-uint8_t EBYTE::GetWORTIming() {
-	return _WORTiming;
-}
+uint32_t EBYTE::AirTimeMicros(uint16_t len) {
 
-/*
-method to Set/Get Transmit Power
-*/
-void EBYTE::SetTransmitPower(uint8_t val) {
-	_TransmitPower = val;
-	BuildREG1byte();
-}
+	uint16_t packets = (len + GetSubPacketBytes() - 1) / GetSubPacketBytes();
+	uint32_t bits	 = ((uint32_t)len + (uint32_t)packets * EBYTE_AIR_OVERHEAD) * 8;
+	uint32_t us		 = (uint32_t)(((uint64_t)bits * 1000000UL) / GetAirDataRateBps());
 
-uint8_t EBYTE::GetTransmitPower() {
-	return _TransmitPower;
+	if (lastModeSet == MODE_WORtransmit) {
+		us += (uint32_t)packets * 500000UL * (GetWORTIming() + 1);
+	}
+	return us;
 }
 
-/*
-method to compute the address based on high and low bits
-*/
-void EBYTE::SetAddress(uint16_t Val) {
-	_AddressHigh = ((Val & 0xFFFF) >> 8);
-	_AddressLow = (Val & 0xFF);
-}
+uint32_t EBYTE::UARTTimeMicros(uint16_t len) {
 
-/*
-method to get the address which is a collection of hi and lo bytes
-*/
-uint16_t EBYTE::GetAddress() {
-	return (_AddressHigh << 8) | (_AddressLow);
-}
+	// start bit, 8 data bits, stop bit and the parity bit if used
+	uint32_t bits = (uint32_t)len * (((GetParityBit() == PB_8O1) || (GetParityBit() == PB_8E1)) ? 11 : 10);
 
-/*
-Set/Get the UART baud rate
-*/
-void EBYTE::SetUARTBaudRate(uint8_t val) {
-	_UARTDataRate = val;
-	BuildREG0byte();
+	return (uint32_t)(((uint64_t)bits * 1000000UL) / baudRates[GetUARTBaudRate()]);
 }
 
-uint8_t EBYTE::GetUARTBaudRate() {
-	return _UARTDataRate;
+uint8_t EBYTE::GetSubPacketBytes() {
+	static const uint8_t bytes[]{ 200, 128, 64, 32 };
+	return bytes[GetSubPacketSize()];
 }
 
 // (**) The following functions are new since E32
@@ -445,12 +509,14 @@ bool EBYTE::GetRSSIValues() {               // (**)
 	uint8_t transaction[6]	= { 0xC0, 0xC1, 0xC2, 0xC3, 0x00, 0x02 };
 	bool	ok				= false;
 
-	if (_RSSIAmbNoiseEnable && ((lastModeSet = MODE_NORMAL) || (lastModeSet = MODE_WORtransmit))) {
+	if (GetRSSIAmbientNoiseEnable() && ((lastModeSet == MODE_NORMAL) || (lastModeSet == MODE_WORtransmit))) {
 
-		if (SendStruct(&transaction, sizeof(transaction))) {
+		// a command to the module, not charged to the duty cycle like SendStruct would
+		if (_s->write(transaction, sizeof(transaction)) == sizeof(transaction)) {
 
+			CompleteTask(1000);
 			delay(50);
-			if (_s->readBytes((uint8_t*)&transaction, 5) == 5) {
+			if ((_s->readBytes((uint8_t*)&transaction, 5) == 5) && (transaction[0] == RETURNED_COMMAND)) {
 				RSSIdata		= transaction[3];
 				RSSIlastReceive = transaction[4];
 				ok				= true;
@@ -463,62 +529,77 @@ bool EBYTE::GetRSSIValues() {               // (**)
 };
 
 /*
-method to build the byte for programming (notice it's a collection of a few variables)
+Method to ask the module for the ambient RSSI without waiting for the answer, see PollRSSI()
 */
-void EBYTE::BuildREG0byte() {
-	_REG0 = 0;
-	_REG0 = (((_UARTDataRate & 0b111) << 5) | ((_ParityBit & 0b11) << 3) | (_AirDataRate & 0b111));
-}
+bool EBYTE::RequestRSSI() {
 
-void EBYTE::BuildREG1byte() {
-	_REG1 = 0;
-	_REG1 = (((_SubPacketSize & 0b11) << 6) | ((_RSSIAmbNoiseEnable & 0b1) << 5) | (_TransmitPower & 0b11));
+	uint8_t command[6] = { 0xC0, 0xC1, 0xC2, 0xC3, 0x00, 0x01 };
+
+	if (!GetRSSIAmbientNoiseEnable() || ((lastModeSet != MODE_NORMAL) && (lastModeSet != MODE_WORtransmit))) {
+		return false;
+	}
+	newRSSIdataAvailable	= false;
+	_RSSIRequested			= millis();
+	_RSSIPending			= true;
+	return (_s->write(command, sizeof(command)) == sizeof(command));
 }
 
-void EBYTE::BuildREG3byte() {
-	_REG3 = 0;
-	_REG3 = (((_EnableRSSIByte & 0b1) << 7) | ((_TransmitMode & 0b1) << 6) | ((_EnableLBT & 0b1) << 4) | (_WORTiming & 0b111));
+/*
+Method to collect the answer to RequestRSSI(). Returns false while it is on its way, true once it is
+in (RSSIdata, newRSSIdataAvailable true) or after 100ms without it (newRSSIdataAvailable false)
+*/
+bool EBYTE::PollRSSI() {
+
+	uint8_t reply[4];
+
+	if (!_RSSIPending) {
+		return true;
+	}
+	if (_s->available() < (int)sizeof(reply)) {
+		if ((millis() - _RSSIRequested) > 100) {
+			_RSSIPending = false;
+			return true;
+		}
+		return false;
+	}
+	_RSSIPending = false;
+
+	// anything else is a packet that came in first, it is dropped and the answer with it
+	if ((_s->readBytes(reply, sizeof(reply)) == sizeof(reply)) && (reply[0] == RETURNED_COMMAND) && (reply[1] == 0x00) && (reply[2] == 0x01)) {
+		RSSIdata				= reply[3];
+		newRSSIdataAvailable	= true;
+	}
+	else {
+		DropPacket();
+	}
+	return true;
 }
 
 bool EBYTE::GetAux() {
 	return digitalReadFast(_AUX);    // (**) changed from digitalRead to digitalReadFast
 }
 
+int8_t EBYTE::GetAuxPin() {
+	return _AUX;
+}
+
 /*
 method to save parameters to the module
 */
 void EBYTE::SaveParameters(PROGRAM_COMMAND_Type val) {
 
-	config.COMMAND			= val;
-	config.STARTING_ADDRESS = 0;
-	config.LENGTH			= 6;
-	config.ADDH				= _AddressHigh;
-	config.ADDL				= _AddressLow;
-	config.Reg0				= _REG0;
-	config.Reg1				= _REG1;
-	config.CHAN				= _Channel;
-	config.Reg3				= _REG3;
+	// inside a transaction the registers are written by Commit()
+	if (_InConfig) {
+		return;
+	}
 
 	SetMode(MODE_PROGRAM);
 
 	// here you can save permanenly or temp
-	delay(5);
-
-	if (!SendStruct(&config, sizeof(config))) {
-		Serial.println(F("Unable to send Config to Tranceiver"));
-	};
-	elapsedMillis t = 0;                //(**)
-	while ( _s->available() == 0 && t < 5000) {};
-
-//	delay(50);   //this is a guess
-
-//	if ( _s->readBytes((uint8_t*)&config, sizeof(config)) != sizeof(config)){
-	if (!GetStruct(&config, sizeof(config))) {
+	if (!WriteRegisters(val, 0, _Image, sizeof(_ModuleImage))) {
 		Serial.println(F("SaveParameters:Unable to Get Config from Tranceiver"));
 	};
 
-	CompleteTask(4000);
-	
 	SetMode(MODE_NORMAL);
 }
 
@@ -528,31 +609,157 @@ method to save Crypt to the module
 */
 void EBYTE::SetCrypt(uint16_t val) {
 
-	uint8_t reply[6];
+	_Image[EBYTE_REG_CRYPTH] = (uint8_t)((val & 0xFFFF) >> 8);
+	_Image[EBYTE_REG_CRYPTL] = (uint8_t)(val & 0xFF);
 
-	_CryptHi = (uint8_t)((val & 0xFFFF) >> 8);
-	_CryptLo = (uint8_t)(val & 0xFF);
+	// inside a transaction the key is written by Commit()
+	if (_InConfig) {
+		_CryptDirty = true;
+		return;
+	}
 
 	SetMode(MODE_PROGRAM);
 
-	delay(5);
-
-	_s->write(WRITE_CFG_PWR_DWN_SAVE);
-	_s->write(0x6);				//Starting address
-	_s->write(0x2);				//Length of data (number of bytes)
-								//I think it's better to set Crypt seperately
-	_s->write(_CryptHi);
-	_s->write(_CryptLo);
-
-	delay(50);
-	if (_s->readBytes((uint8_t*)&reply, 5) != 5) {
-		//	if (!getStruct(&config, sizeof(config))) {
+	if (!WriteRegisters(WRITE_CFG_PWR_DWN_SAVE, EBYTE_REG_CRYPTH, &_Image[EBYTE_REG_CRYPTH], 2)) {
 		Serial.println(F("Unable to Set Crypt in Tranceiver"));
 	};
 
-	CompleteTask(4000);
+	SetMode(MODE_NORMAL);
+}
+
+/*
+method to start a configuration transaction
+*/
+void EBYTE::BeginConfig() {
+	_InConfig	= true;
+	_CryptDirty = false;
+}
+
+/*
+method to end a configuration transaction. Only registers that differ from the module are written,
+the crypt key (address 0x06) sits right after the main block so the whole change is one command
+*/
+bool EBYTE::Commit(PROGRAM_COMMAND_Type val) {
+
+	uint8_t first		= sizeof(_Image);
+	uint8_t last		= 0;
+	bool	ok;
+
+	// TEMPORARY changes are lost at power down, so when saving permanently rewrite the whole block
+	bool	all			= (val == WRITE_CFG_PWR_DWN_SAVE) && _ModuleTemporary;
+
+	_InConfig = false;
+
+	for (uint8_t i = 0; i < sizeof(_ModuleImage); i++) {
+		if (all || (_Image[i] != _ModuleImage[i])) {
+			if (first == sizeof(_Image)) {
+				first = i;
+			}
+			last = i;
+		}
+	}
+
+	// the crypt key is write only so it can't be compared with the module
+	if (_CryptDirty) {
+		if (first == sizeof(_Image)) {
+			first = EBYTE_REG_CRYPTH;
+		}
+		last = EBYTE_REG_CRYPTL;
+	}
+	_CryptDirty = false;
+
+	// nothing changed, stay out of program mode
+	if (first == sizeof(_Image)) {
+		return true;
+	}
+
+	SetMode(MODE_PROGRAM);
+
+	ok = WriteRegisters(val, first, &_Image[first], last - first + 1);
+	if (!ok) {
+		Serial.println(F("Commit: Unable to verify Config in Tranceiver"));
+	}
+
+	SetMode(MODE_NORMAL);
+
+	return ok;
+}
+
+/*
+method to write registers while in program mode. The module replies with C1, the starting address,
+the length and the registers as written, so the reply is the read back
+*/
+bool EBYTE::WriteRegisters(PROGRAM_COMMAND_Type cmd, uint8_t start, const uint8_t *data, uint8_t len) {
+
+	uint8_t reply[3 + 8];
+	bool	ok;
+
+	if ((len == 0) || ((start + len) > 8)) {
+		return false;
+	}
+
+	_s->write((uint8_t)cmd);
+	_s->write(start);				//Starting address
+	_s->write(len);					//Length of data (number of bytes)
+	_s->write(data, len);
+
+	ok = (_s->readBytes(reply, 3 + len) == (size_t)(3 + len));
+	ok = ok && (reply[0] == RETURNED_COMMAND) && (reply[1] == start) && (reply[2] == len);
+
+	// crypt registers read back as 0 so only the main block is compared
+	for (uint8_t i = 0; ok && (i < len) && ((start + i) < sizeof(_ModuleImage)); i++) {
+		ok = (reply[3 + i] == data[i]);
+	}
+
+	// the reply is back so the module is done, with AUX no need for CompleteTask's extra 20ms
+	if (_AUX != -1) {
+		WaitForAUX(4000);
+	}
+	else {
+		CompleteTask(4000);
+	}
+
+	if (ok) {
+		for (uint8_t i = 0; (i < len) && ((start + i) < sizeof(_ModuleImage)); i++) {
+			_ModuleImage[start + i] = data[i];
+		}
+		if (cmd == WRITE_CFG_PWR_DWN_LOSE) {
+			_ModuleTemporary = true;
+		}
+		else if ((start == 0) && (len >= sizeof(_ModuleImage))) {
+			_ModuleTemporary = false;
+		}
+		if ((cmd == WRITE_CFG_PWR_DWN_SAVE) && (start < sizeof(_ModuleImage))) {
+			SaveCache();
+		}
+	}
+	return ok;
+}
+
+/*
+method to read the channel alone. After a reset of the MCU but not of the module, the module may still
+be on a channel set TEMPORARY (SetChannelFast) that the cache, a permanent image, doesn't have
+*/
+bool EBYTE::ReadChannel() {
+
+	uint8_t request[3]	= { READ_CONFIGURATION, EBYTE_REG_CHAN, 1 };
+	uint8_t reply[4];
+	bool	ok;
+
+	SetMode(MODE_PROGRAM);
+
+	ok = (_s->write(request, sizeof(request)) == sizeof(request));
+	ok = ok && (_s->readBytes(reply, sizeof(reply)) == sizeof(reply));
+	ok = ok && (reply[0] == RETURNED_COMMAND) && (reply[1] == EBYTE_REG_CHAN) && (reply[2] == 1);
 
 	SetMode(MODE_NORMAL);
+
+	if (ok && (reply[3] != _ModuleImage[EBYTE_REG_CHAN])) {
+		_Image[EBYTE_REG_CHAN]			= reply[3];
+		_ModuleImage[EBYTE_REG_CHAN]	= reply[3];
+		_ModuleTemporary				= true;
+	}
+	return ok;
 }
 
 /*
@@ -562,103 +769,130 @@ and any method updates the variables
 
 void EBYTE::PrintParameters() {
 
-	_UARTDataRate			= (_REG0 & 0b11100000) >> 5;
-	_ParityBit				= (_REG0 & 0b00011000) >> 3;
-	_AirDataRate			= (_REG0 & 0b00000111);
-	_SubPacketSize			= (_REG1 & 0b11000000) >> 6;
-	_RSSIAmbNoiseEnable		= (_REG1 & 0b00100000) >> 5;
-	_TransmitPower			= (_REG1 & 0b00000011);
-
-	_EnableRSSIByte			= (_REG3 & 0b10000000) >> 7;
-	_TransmitMode			= (_REG3 & 0b01000000) >> 6;
-	_EnableLBT				= (_REG3 & 0b00010000) >> 4;
-	_WORTiming				= (_REG3 & 0b00000111);
-
 	SerialUSB.println("----------------------------------------");
-	SerialUSB.print(F("Mode (HEX/DEC/BIN): "));  SerialUSB.print(_Save, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_Save, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_Save, BIN);
-	SerialUSB.print(F("AddH (HEX/DEC/BIN): "));  SerialUSB.print(_AddressHigh, HEX); SerialUSB.print(F("/")); SerialUSB.print(_AddressHigh, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_AddressHigh, BIN);
-	SerialUSB.print(F("AddL (HEX/DEC/BIN): "));  SerialUSB.print(_AddressLow, HEX); SerialUSB.print(F("/")); SerialUSB.print(_AddressLow, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_AddressLow, BIN);
-	SerialUSB.print(F("REG0 (HEX/DEC/BIN): "));  SerialUSB.print(_REG0, HEX); SerialUSB.print(F("/")); SerialUSB.print(_REG0, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_REG0, BIN);
-	SerialUSB.print(F("REG1 (HEX/DEC/BIN): "));  SerialUSB.print(_REG1, HEX); SerialUSB.print(F("/")); SerialUSB.print(_REG1, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_REG1, BIN);
-	SerialUSB.print(F("Chan (HEX/DEC/BIN): "));  SerialUSB.print(_Channel, HEX); SerialUSB.print(F("/")); SerialUSB.print(_Channel, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_Channel, BIN);
-	SerialUSB.print(F("REG3 (HEX/DEC/BIN): "));  SerialUSB.print(_REG3, HEX); SerialUSB.print(F("/")); SerialUSB.print(_REG3, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_REG3, BIN);
+	SerialUSB.print(F("AddH (HEX/DEC/BIN): "));  SerialUSB.print(GetAddressH(), HEX); SerialUSB.print(F("/")); SerialUSB.print(GetAddressH(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetAddressH(), BIN);
+	SerialUSB.print(F("AddL (HEX/DEC/BIN): "));  SerialUSB.print(GetAddressL(), HEX); SerialUSB.print(F("/")); SerialUSB.print(GetAddressL(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetAddressL(), BIN);
+	SerialUSB.print(F("REG0 (HEX/DEC/BIN): "));  SerialUSB.print(_Image[EBYTE_REG_REG0], HEX); SerialUSB.print(F("/")); SerialUSB.print(_Image[EBYTE_REG_REG0], DEC); SerialUSB.print(F("/"));  SerialUSB.println(_Image[EBYTE_REG_REG0], BIN);
+	SerialUSB.print(F("REG1 (HEX/DEC/BIN): "));  SerialUSB.print(_Image[EBYTE_REG_REG1], HEX); SerialUSB.print(F("/")); SerialUSB.print(_Image[EBYTE_REG_REG1], DEC); SerialUSB.print(F("/"));  SerialUSB.println(_Image[EBYTE_REG_REG1], BIN);
+	SerialUSB.print(F("Chan (HEX/DEC/BIN): "));  SerialUSB.print(GetChannel(), HEX); SerialUSB.print(F("/")); SerialUSB.print(GetChannel(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetChannel(), BIN);
+	SerialUSB.print(F("REG3 (HEX/DEC/BIN): "));  SerialUSB.print(_Image[EBYTE_REG_REG3], HEX); SerialUSB.print(F("/")); SerialUSB.print(_Image[EBYTE_REG_REG3], DEC); SerialUSB.print(F("/"));  SerialUSB.println(_Image[EBYTE_REG_REG3], BIN);
 	SerialUSB.print(F("Addr (HEX/DEC/BIN): "));  SerialUSB.print(GetAddress(), HEX); SerialUSB.print(F("/")); SerialUSB.print(GetAddress(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetAddress(), BIN);
 	SerialUSB.println(F(" "));
 
-	SerialUSB.print(F("UARTDataRate (HEX/DEC/BIN)               : "));  SerialUSB.print(_UARTDataRate, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_UARTDataRate, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_UARTDataRate, BIN);
-	SerialUSB.print(F("ParityBit (HEX/DEC/BIN)	                 : "));  SerialUSB.print(_ParityBit, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_ParityBit, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_ParityBit, BIN);
-	SerialUSB.print(F("AirDataRate (HEX/DEC/BIN)                : "));  SerialUSB.print(_AirDataRate, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_AirDataRate, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_AirDataRate, BIN);
+	SerialUSB.print(F("UARTDataRate (HEX/DEC/BIN)               : "));  SerialUSB.print(GetUARTBaudRate(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetUARTBaudRate(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetUARTBaudRate(), BIN);
+	SerialUSB.print(F("ParityBit (HEX/DEC/BIN)	                 : "));  SerialUSB.print(GetParityBit(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetParityBit(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetParityBit(), BIN);
+	SerialUSB.print(F("AirDataRate (HEX/DEC/BIN)                : "));  SerialUSB.print(GetAirDataRate(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetAirDataRate(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetAirDataRate(), BIN);
 
-	SerialUSB.print(F("Packet Size (HEX/DEC/BIN)                : "));  SerialUSB.print(_SubPacketSize, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_SubPacketSize, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_SubPacketSize, BIN);
-	SerialUSB.print(F("Enable RSSI Ambient Noise (HEX/DEC/BIN)  : "));  SerialUSB.print(_RSSIAmbNoiseEnable, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_RSSIAmbNoiseEnable, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_RSSIAmbNoiseEnable, BIN);
-	SerialUSB.print(F("Transmit Power (HEX/DEC/BIN)             : "));  SerialUSB.print(_TransmitPower, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_TransmitPower, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_TransmitPower, BIN);
+	SerialUSB.print(F("Packet Size (HEX/DEC/BIN)                : "));  SerialUSB.print(GetSubPacketSize(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetSubPacketSize(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetSubPacketSize(), BIN);
+	SerialUSB.print(F("Enable RSSI Ambient Noise (HEX/DEC/BIN)  : "));  SerialUSB.print(GetRSSIAmbientNoiseEnable(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetRSSIAmbientNoiseEnable(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetRSSIAmbientNoiseEnable(), BIN);
+	SerialUSB.print(F("Transmit Power (HEX/DEC/BIN)             : "));  SerialUSB.print(GetTransmitPower(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetTransmitPower(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetTransmitPower(), BIN);
 
-	SerialUSB.print(F("Enable RSSI byte (HEX/DEC/BIN)           : "));  SerialUSB.print(_EnableRSSIByte, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_EnableRSSIByte, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_EnableRSSIByte, BIN);
-	SerialUSB.print(F("TransMode (HEX/DEC/BIN)                  : "));  SerialUSB.print(_TransmitMode, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_TransmitMode, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_TransmitMode, BIN);
-	SerialUSB.print(F("Enable LBT (HEX/DEC/BIN)                 : "));  SerialUSB.print(_EnableLBT, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_EnableLBT, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_EnableLBT, BIN);
-	SerialUSB.print(F("WOR Timing (HEX/DEC/BIN)                 : "));  SerialUSB.print(_WORTiming, HEX); SerialUSB.print(F("/"));  SerialUSB.print(_WORTiming, DEC); SerialUSB.print(F("/"));  SerialUSB.println(_WORTiming, BIN);
+	SerialUSB.print(F("Enable RSSI byte (HEX/DEC/BIN)           : "));  SerialUSB.print(GetEnableRSSIByte(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetEnableRSSIByte(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetEnableRSSIByte(), BIN);
+	SerialUSB.print(F("TransMode (HEX/DEC/BIN)                  : "));  SerialUSB.print(GetTransmissionMode(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetTransmissionMode(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetTransmissionMode(), BIN);
+	SerialUSB.print(F("Enable LBT (HEX/DEC/BIN)                 : "));  SerialUSB.print(GetEnableLBT(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetEnableLBT(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetEnableLBT(), BIN);
+	SerialUSB.print(F("WOR Timing (HEX/DEC/BIN)                 : "));  SerialUSB.print(GetWORTIming(), HEX); SerialUSB.print(F("/"));  SerialUSB.print(GetWORTIming(), DEC); SerialUSB.print(F("/"));  SerialUSB.println(GetWORTIming(), BIN);
 
 	SerialUSB.println("----------------------------------------");
 
 }
 
 /*
-method to read parameters, 
+method to read parameters, the registers are only replaced by a complete reply
 */
 bool EBYTE::ReadParameters() {
 
-	config.COMMAND			= READ_CONFIGURATION;
-	config.STARTING_ADDRESS = 0;
-	config.LENGTH			= 6;
-	config.ADDH				= _AddressHigh;
-	config.ADDL				= _AddressLow;
-	config.Reg0				= _REG0;
-	config.Reg1				= _REG1;
-	config.CHAN				= _Channel;
-	config.Reg3				= _REG3;
+	uint8_t request[3]	= { READ_CONFIGURATION, 0, sizeof(_ModuleImage) };
+	uint8_t reply[3 + sizeof(_ModuleImage)];
+	bool	ok;
 
 	SetMode(MODE_PROGRAM);
 
-	if (!SendStruct(&config, 3)) {
+	if (_s->write(request, sizeof(request)) != sizeof(request)) {
 		Serial.println(F("Unable to send Config to Tranceiver"));
 	};
 
-	delay(50);   //this is a guess
-
-	if (_s->readBytes((uint8_t*)&config, sizeof(config)) != sizeof(config)) {
+	// readBytes returns as soon as the reply has arrived (or the stream timeout passes)
+	ok = (_s->readBytes(reply, sizeof(reply)) == sizeof(reply));
+	if (!ok) {
 		Serial.println(F("ReadParameteres: Unable to Get Config from Tranceiver"));
 	};
 
-	_Save					= config.COMMAND;
-	_AddressHigh			= config.ADDH;
-	_AddressLow				= config.ADDL;
-	_REG0					= config.Reg0;
-	_REG1					= config.Reg1;
-	_Channel				= config.CHAN;
-	_REG3					= config.Reg3;
-
-	_Address				=  (_AddressHigh << 8) | (_AddressLow);
-	_UARTDataRate			= (_REG0 & 0b11100000) >> 5;
-	_ParityBit				= (_REG0 & 0b00011000) >> 3;
-	_AirDataRate			= (_REG0 & 0b00000111);
-
-	_SubPacketSize			= (_REG1 & 0b11000000) >> 6;        //(**)
-	_RSSIAmbNoiseEnable		= (_REG1 & 0b00100000) >> 4;
-	_TransmitPower			= (_REG1 & 0b00000011);
-
-	_EnableRSSIByte			= (_REG3 & 0b10000000) >> 7;
-	_TransmitMode			= (_REG3 & 0b01000000) >> 6;
-	_EnableLBT				= (_REG3 & 0b00010000) >> 4;
-	_WORTiming				= (_REG3 & 0b00000111);
-	
 	SetMode(MODE_NORMAL);
 
-	if (_Save != RETURNED_COMMAND){
+	if (!ok || (reply[0] != RETURNED_COMMAND)){
 		return false;
 	}
+
+	memcpy(_Image, &reply[3], sizeof(_ModuleImage));
+	memcpy(_ModuleImage, &reply[3], sizeof(_ModuleImage));
+	SaveCache();
+
 	return true;	
 }
 
+/*
+method to set the store used to keep a copy of the module's permanent register image
+*/
+void EBYTE::SetConfigCache(ebyteCacheLoadFunc load, ebyteCacheSaveFunc save) {
+	_CacheLoad = load;
+	_CacheSave = save;
+}
+
+/*
+CRC-8 (polynomial 0x07) over the cache record, catches blank or half written stores
+*/
+static uint8_t CacheChecksum(const uint8_t *data, uint8_t len) {
+
+	uint8_t crc = 0;
+
+	while (len--) {
+		crc ^= *data++;
+		for (uint8_t i = 0; i < 8; i++) {
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/*
+method to take the register image from the cache, returns false if there is no cache or it is not valid
+*/
+bool EBYTE::LoadCache() {
+
+	uint8_t record[EBYTE_CACHE_SIZE];
+
+	if (!_CacheLoad || !_CacheLoad(record, sizeof(record))) {
+		return false;
+	}
+	if ((record[0] != EBYTE_CACHE_MAGIC) || (record[7] != CacheChecksum(record, 7))) {
+		return false;
+	}
+
+	memcpy(_Image, &record[1], sizeof(_ModuleImage));
+	memcpy(_ModuleImage, &record[1], sizeof(_ModuleImage));
+
+	return true;
+}
+
+/*
+method to store the module's register image in the cache. Only called when the module holds
+no TEMPORARY changes, as those are lost at power down
+*/
+void EBYTE::SaveCache() {
+
+	uint8_t record[EBYTE_CACHE_SIZE];
+
+	if (!_CacheSave || _ModuleTemporary) {
+		return;
+	}
+
+	record[0] = EBYTE_CACHE_MAGIC;
+	memcpy(&record[1], _ModuleImage, sizeof(_ModuleImage));
+	record[7] = CacheChecksum(record, 7);
+
+	_CacheSave(record, sizeof(record));
+}
+
 /*
 method to clear the serial buffer
 
@@ -113,6 +113,20 @@ enum PROGRAM_COMMAND_Type {
 
 #define PERMANENT WRITE_CFG_PWR_DWN_SAVE
 #define TEMPORARY WRITE_CFG_PWR_DWN_LOSE
+
+// offsets in the register image, the same as the module's register addresses
+#define EBYTE_REG_ADDH		0
+#define EBYTE_REG_ADDL		1
+#define EBYTE_REG_REG0		2
+#define EBYTE_REG_REG1		3
+#define EBYTE_REG_CHAN		4
+#define EBYTE_REG_REG3		5
+#define EBYTE_REG_CRYPTH	6
+#define EBYTE_REG_CRYPTL	7
+
+// record kept by the optional configuration cache: magic, ADDH, ADDL, REG0, REG1, CHAN, REG3, CRC-8
+#define EBYTE_CACHE_SIZE	8
+#define EBYTE_CACHE_MAGIC	0xE2
 /***************
 **    REG0    **
 ****************/
@@ -236,7 +250,29 @@ enum PROGRAM_COMMAND_Type {
 #define OPT_WAKEUP3500 0b110
 #define OPT_WAKEUP4000 0b111
 
+// bytes of preamble and header the module adds to each sub packet on air, used for airtime estimates
+#define EBYTE_AIR_OVERHEAD	8
+
+// bytes the module can buffer from the UART while it is transmitting
+#define EBYTE_MODULE_BUFFER	400
+
+/*
+type ids for Send<T>() and EBYTEDispatcher. Every message struct must be registered once, with the
+same id on sender and receiver, in a .h file shared by both sketches:
+	EBYTE_MESSAGE(DATA, 1)
+*/
+template <typename T>
+struct EBYTEMessageId {
+	static_assert(sizeof(T) == 0, "message type not registered, use EBYTE_MESSAGE(Type, Id)");
+};
+
+#define EBYTE_MESSAGE(Type, Id)	template <> struct EBYTEMessageId<Type> { static const uint8_t value = (Id); };
+
+// frame handed on by the layers that carry a source address (EBYTERouter, EBYTETdmaGateway)
+typedef void (*ebyteReceiveFunc) (uint16_t src, const uint8_t *data, uint8_t len);
+
 class Stream;
+class EBYTEDutyCycle;
 
 class EBYTE {
 
@@ -255,31 +291,63 @@ public:
 
 	bool	init(ebyteCallbackFunc func = nullptr);
 
+	// optional store (EEPROM, flash, RTC RAM...) for a checksummed copy of the module's permanent register
+	// image. When set before init() and the stored copy is valid, init() reads only the channel, which
+	// SetChannelFast may have left TEMPORARY in a module that kept its power through an MCU reset; other
+	// TEMPORARY changes are only gone after the module is powered down.
+	// load fills len bytes and returns false if nothing is stored, save writes len bytes. The cache is
+	// refreshed whenever the registers are read or saved PERMANENT
+	typedef bool (*ebyteCacheLoadFunc) (uint8_t *data, uint8_t len);
+	typedef void (*ebyteCacheSaveFunc) (const uint8_t *data, uint8_t len);
+
+	void	SetConfigCache(ebyteCacheLoadFunc load, ebyteCacheSaveFunc save);
+
+	// optional airtime budget (EBYTE_DutyCycle.h). When set every SendByte, SendBytes, SendFrame,
+	// SendStruct and Send is charged its airtime, and waits or fails as the budget's policy says.
+	// nullptr removes it
+
+	void	SetDutyCycle(EBYTEDutyCycle *budget);
+	EBYTEDutyCycle	*GetDutyCycle();
+
 	// methods to set modules working parameters NOTHING WILL BE SAVED UNLESS SaveParameters() is called
 	void	SetMode(MODE_TYPE mode = MODE_NORMAL);
-	void	SetAddress(uint16_t val = 0);
-	void	SetAddressH(uint8_t val = 0);
-	void	SetAddressL(uint8_t val = 0);
+
+	// method to change mode with no fixed delays, returns once AUX is back up (deep sleep wake ups)
+	// GetModeLatency() is the us the last SetModeFast() took, from the pins changing to AUX high
+	bool	SetModeFast(MODE_TYPE mode);
+	uint32_t GetModeLatency();
+	void	SetAddress(uint16_t val = 0)		{ _Image[EBYTE_REG_ADDH] = val >> 8; _Image[EBYTE_REG_ADDL] = val & 0xFF; }
+	void	SetAddressH(uint8_t val = 0)		{ _Image[EBYTE_REG_ADDH] = val; }
+	void	SetAddressL(uint8_t val = 0)		{ _Image[EBYTE_REG_ADDL] = val; }
 //REG0
-	void	SetUARTBaudRate(uint8_t val);
-	void	SetParityBit(uint8_t val);
-	void	SetAirDataRate(uint8_t val);
+	void	SetUARTBaudRate(uint8_t val)		{ SetBits(EBYTE_REG_REG0, 5, 0b111, val); }
+	void	SetParityBit(uint8_t val)			{ SetBits(EBYTE_REG_REG0, 3, 0b11, val); }
+	void	SetAirDataRate(uint8_t val)			{ SetBits(EBYTE_REG_REG0, 0, 0b111, val); }
 //REG1
-	void	SetSubPacketSize(uint8_t val);
-	void	SetRSSIAmbientNoiseEnable(bool val);
-	void	SetTransmitPower(uint8_t val);
+	void	SetSubPacketSize(uint8_t val)		{ SetBits(EBYTE_REG_REG1, 6, 0b11, val); }
+	void	SetRSSIAmbientNoiseEnable(bool val)	{ SetBits(EBYTE_REG_REG1, 5, 0b1, val); }
+	void	SetTransmitPower(uint8_t val)		{ SetBits(EBYTE_REG_REG1, 0, 0b11, val); }
 //REG2
-	void	SetChannel(uint8_t val);
+	void	SetChannel(uint8_t val)				{ _Image[EBYTE_REG_CHAN] = val; }
+
+	// method to change channel straight away: one TEMPORARY write of the channel register, nothing else.
+	// The module is returned to the mode it was in. Anything not yet read from the module is lost.
+	// Refused (false) between BeginConfig() and Commit()
+
+	bool	SetChannelFast(uint8_t val);
 //REG3
-	void	SetEnableRSSIByte(bool val);
-	void	SetTransmissionMode(uint8_t val);
-	void	SetEnableLBT(bool val);
-	void	SetWORTIming(uint8_t val);
+	void	SetEnableRSSIByte(bool val)			{ SetBits(EBYTE_REG_REG3, 7, 0b1, val); }
+	void	SetTransmissionMode(uint8_t val)	{ SetBits(EBYTE_REG_REG3, 6, 0b1, val); }
+	void	SetEnableLBT(bool val)				{ SetBits(EBYTE_REG_REG3, 4, 0b1, val); }
+	void	SetWORTIming(uint8_t val)			{ SetBits(EBYTE_REG_REG3, 0, 0b111, val); }
 
 	void	SetCrypt(uint16_t val);
 
 	bool	GetAux();
 
+	// the AUX pin number, -1 if there is none. For layers that timestamp AUX edges with attachInterrupt
+	int8_t	GetAuxPin();
+
 	bool	available();
 	void	flush();
 
@@ -287,41 +355,93 @@ public:
 *	 methods to get some operating parameters    *
 **************************************************/
 
-	uint16_t GetAddress();
+	uint16_t GetAddress()					{ return (_Image[EBYTE_REG_ADDH] << 8) | _Image[EBYTE_REG_ADDL]; }
 
 	// methods to get module data
 //	uint8_t GetModel();        (**) Not in E220
 
-	uint8_t GetAddressH();
-	uint8_t GetAddressL();
+	uint8_t GetAddressH()					{ return _Image[EBYTE_REG_ADDH]; }
+	uint8_t GetAddressL()					{ return _Image[EBYTE_REG_ADDL]; }
 //REG0
-	uint8_t GetUARTBaudRate();
-	uint8_t GetParityBit();
-	uint8_t GetAirDataRate();
+	uint8_t GetUARTBaudRate()				{ return Bits(EBYTE_REG_REG0, 5, 0b111); }
+	uint8_t GetParityBit()					{ return Bits(EBYTE_REG_REG0, 3, 0b11); }
+	uint8_t GetAirDataRate()				{ return Bits(EBYTE_REG_REG0, 0, 0b111); }
+	uint32_t GetAirDataRateBps();		// air data rate in bits per second
 //REG1
-	uint8_t GetSubPacketSize();
-	bool	GetRSSIAmbientNoiseEnable();
-	uint8_t GetTransmitPower();
+	uint8_t GetSubPacketSize()				{ return Bits(EBYTE_REG_REG1, 6, 0b11); }
+	uint8_t GetSubPacketBytes();		// sub packet size in bytes (200, 128, 64 or 32)
+
+	// method to estimate the time on air of len bytes with the current air data rate and sub packet size,
+	// the WOR preamble included in MODE_WORtransmit
+	uint32_t AirTimeMicros(uint16_t len);
+
+	// method to get the time to move len bytes over the UART at the current UART rate and parity
+	uint32_t UARTTimeMicros(uint16_t len);
+	bool	GetRSSIAmbientNoiseEnable()		{ return Bits(EBYTE_REG_REG1, 5, 0b1); }
+	uint8_t GetTransmitPower()				{ return Bits(EBYTE_REG_REG1, 0, 0b11); }
 //REG2
-	uint8_t GetChannel();
+	uint8_t GetChannel()					{ return _Image[EBYTE_REG_CHAN]; }
+	uint8_t GetModuleChannel()				{ return _ModuleImage[EBYTE_REG_CHAN]; }	// as last written to or read from the module
 //REG3
-	bool	GetEnableRSSIByte();
-	uint8_t GetTransmissionMode();
-	bool	GetEnableLBT();
-	uint8_t GetWORTIming();
+	bool	GetEnableRSSIByte()				{ return Bits(EBYTE_REG_REG3, 7, 0b1); }
+	uint8_t GetTransmissionMode()			{ return Bits(EBYTE_REG_REG3, 6, 0b1); }
+	bool	GetEnableLBT()					{ return Bits(EBYTE_REG_REG3, 4, 0b1); }
+	uint8_t GetWORTIming()					{ return Bits(EBYTE_REG_REG3, 0, 0b111); }
 
 	// Method to get RSSIdata and RSSIlastReceive if _RSSIAmbNoiseEnable turned on and mode is MODE_NORMAL OR MODE_WAKEUP
 	bool	GetRSSIValues();
 
+	// the same without waiting: RequestRSSI() asks for the ambient RSSI, PollRSSI() returns true once the
+	// answer is in RSSIdata (newRSSIdataAvailable true) or has timed out (false). Read any waiting
+	// packet first, a packet arriving before the answer is dropped with it
+	bool	RequestRSSI();
+	bool	PollRSSI();
+
 	// methods to get data from sending unit
 	uint8_t GetByte();
 
+	// method to read bytes as they come, without the RSSI byte handling or waiting for the module
+	// GetStruct does. For layers that read a header first and the rest of the packet with GetStruct
+	uint16_t GetBytes(void *TheData, uint16_t size_);
+
+	// method to throw away the rest of a packet whose length isn't known
+	void	DropPacket();
+
 	// Method to get structured data. If EnableRSSIByte is true then the RSSIbyte will be read and placed in the variable RSSIdata
-	bool	GetStruct(const void *TheStructure, uint16_t size_);  // Gets struct data and RSSIdata if sender _EnableRSSIByte turned on.
+	bool	GetStruct(void *TheStructure, uint16_t size_);  // Gets struct data and RSSIdata if sender _EnableRSSIByte turned on.
 	
 	// method to send to data to receiving unit
 	void	SendByte(uint8_t TheByte);
+
+	// method to write bytes without waiting for the module to finish, for layers that pace writes themselves
+	// urgent frames may use the duty cycle reserve, see SetDutyCycle
+	uint16_t SendBytes(const void *TheData, uint16_t size_, bool urgent = false);
+
+	// the same for a frame written in two parts (a header, then its payload): charged to the duty cycle
+	// once as one frame, and either all of it is written or none. Returns the bytes written
+	uint16_t SendFrame(const void *Header, uint16_t headerSize, const void *Payload, uint16_t payloadSize, bool urgent = false);
+
 	bool	SendStruct(const void *TheStructure, uint16_t size_);
+
+	// method to send a message type registered with EBYTE_MESSAGE(Type, Id). The type id goes first so
+	// an EBYTEDispatcher (EBYTE_Dispatcher.h) on the receiving end can call the matching handler
+	// returns false if the message and its id don't fit the current sub packet size
+	template <typename T>
+	bool	Send(const T &TheMessage) {
+		// builtin rather than std::is_trivially_copyable, AVR has no <type_traits>
+		static_assert(__is_trivially_copyable(T), "Send<T>: T must be trivially copyable");
+		static_assert(sizeof(T) + 1 <= 200, "Send<T>: T and its type id must fit a 200 byte sub packet");
+
+		if ((sizeof(T) + 1) > GetSubPacketBytes()) {
+			return false;
+		}
+		// one write, so the id and message are charged as the one packet they are on air
+		uint8_t buf[sizeof(T) + 1];
+
+		buf[0] = EBYTEMessageId<T>::value;
+		memcpy(&buf[1], &TheMessage, sizeof(T));
+		return SendStruct(buf, sizeof(buf));
+	}
 	
 	// mehod to print parameters
 	void	PrintParameters();
@@ -330,6 +450,13 @@ public:
 	// notion here is you can set several but save once as opposed to saving on each parameter change
 	// you can save permanently (retained at start up, or temp which is ideal for dynamically changing the address or frequency
 	void SaveParameters(PROGRAM_COMMAND_Type val = PERMANENT);
+
+	// configuration transaction. Between BeginConfig() and Commit() the Set methods, SaveParameters()
+	// and SetCrypt() only change the class variables. Commit() then enters program mode once, writes
+	// every register that differs from the module (and the crypt key if set) in a single C0/C2 command,
+	// checks the module's reply against what was written and returns to normal mode
+	void BeginConfig();
+	bool Commit(PROGRAM_COMMAND_Type val = PERMANENT);
 	
 	uint8_t RSSIdata		= 0;    // store for RSSIdata received when _EnableRSSIByte is true or from GetRSSIValues()
 	uint8_t RSSIlastReceive = 0;	// returned from GetRSSIValues(). Value of RSSI on last receive.
@@ -353,18 +480,32 @@ protected:
 
 	// method to let method know of module is busy doing something (timeout provided to avoid lockups)
 	void CompleteTask(unsigned long timeout = 0);
+
+	// method to wait for AUX to go high without the fixed recovery delay, false on timeout
+	bool WaitForAUX(unsigned long timeout);
 	
-/*
-	Utility methodS to build the bytes for programming (notice it's a collection of a few variables)
-*/
-	void BuildREG0byte();
-	void BuildREG1byte(); 
-	void BuildREG3byte();
+	// method to write len bytes starting at register address start while in program mode
+	// returns true if the module echoes back exactly what was written
+	bool WriteRegisters(PROGRAM_COMMAND_Type cmd, uint8_t start, const uint8_t *data, uint8_t len);
 
 private:
 
 //	bool ReadModelData();		//(**) Not available on E220
 	void ClearBuffer();
+	void WritePins(MODE_TYPE mode);
+
+	// the bits of a setting in the register image
+	uint8_t Bits(uint8_t reg, uint8_t shift, uint8_t mask) {
+		return (_Image[reg] >> shift) & mask;
+	}
+	void SetBits(uint8_t reg, uint8_t shift, uint8_t mask, uint8_t val) {
+		_Image[reg] = (_Image[reg] & ~(mask << shift)) | ((val & mask) << shift);
+	}
+
+	bool ReadChannel();
+	bool LoadCache();
+	void SaveCache();
+	bool Charge(uint16_t len, bool urgent);
 	// variable for the serial stream
 	Stream*  _s;
 	Stream*  _TD;
@@ -376,56 +517,27 @@ private:
 
 	MODE_TYPE lastModeSet = MODE_NOT_SET;
 
-#pragma pack(push,1)
-
-	struct ConfigurationType {
-		byte COMMAND = 0;
-		byte STARTING_ADDRESS = 0;
-		byte LENGTH = 0;
-
-		byte ADDH = 0;
-		byte ADDL = 0;
-//		byte NETID = 0;		//Used in E22
-
-		byte Reg0;
-		byte Reg1;
-
-		byte CHAN = 0;
-		byte Reg3;
-
-	};
-	ConfigurationType config;
-
-#pragma pack(pop)
-
-	// indicidual variables for each of the 6 bytes
-	// _Params could be used as the main variable storage, but since some bytes
-	// are a collection of several options, let's just make storage consistent
-	// also Param[1] is different data depending on the _Save variable
-	uint8_t		_Save;
-	uint8_t		_AddressHigh;
-	uint8_t		_AddressLow;
-	uint8_t		_REG0;
-	uint8_t		_REG1;
-	uint8_t		_REG2;
-	uint8_t		_Channel;	//Same as REG2
-	uint8_t		_REG3;
-	uint8_t		_CryptHi;
-	uint8_t		_CryptLo;
-
-	// individual variables for all the options
-	uint8_t		_UARTDataRate;					//REG0 xxx_ ____
-	uint8_t		_ParityBit;						//REG0 ___x x___
-	uint8_t		_AirDataRate;					//REG0 ____ _xxx
-	uint8_t		_SubPacketSize;					//REG1 xx_. ..__    "." = Reserved bit
-	bool		_RSSIAmbNoiseEnable = false;	//REG1 __x. ..__
-	uint8_t		_TransmitPower;					//REG1 ____ __xx
-	bool		_EnableRSSIByte		= true;		//REG3 x_._ .___	Set true to catch any extra bytes sent while being set-up and possibly not fully under control
-	uint8_t		_TransmitMode;					//REG3 _x._ .___
-	bool		_EnableLBT			= false;	//REG3 __.x .___
-	uint8_t		_WORTiming;						//REG3 __._ .xxx
-	uint16_t	_Address;
-	uint8_t		_buf;
+	// the registers as written to the module: ADDH, ADDL, REG0, REG1, CHAN, REG3, CRYPT_H, CRYPT_L
+	// every setting lives here and nowhere else, the Get/Set methods work on its bits
+	// until init() reads the module: 9600 8N1, 2.4k air rate and the RSSI byte on, to catch
+	// any extra bytes sent while being set up
+	uint8_t		_Image[8]			= { 0, 0, (UDR_9600 << 5) | (PB_8N1 << 3) | ADR_2400, 0, 0, 0x80, 0, 0 };
+
+	// last register image (ADDH, ADDL, REG0, REG1, CHAN, REG3) known to be in the module
+	uint8_t		_ModuleImage[6]		= {};
+	bool		_ModuleTemporary	= false;	// module holds TEMPORARY changes not yet saved permanently
+	bool		_InConfig			= false;	// between BeginConfig() and Commit()
+	bool		_CryptDirty			= false;	// SetCrypt() called inside a transaction
+
+	ebyteCacheLoadFunc	_CacheLoad	= nullptr;
+	ebyteCacheSaveFunc	_CacheSave	= nullptr;
+
+	EBYTEDutyCycle		*_DutyCycle	= nullptr;
+
+	bool				_RSSIPending	= false;	// RequestRSSI() sent, answer not read
+	unsigned long		_RSSIRequested	= 0;
+
+	uint32_t			_ModeLatency	= 0;		// us of the last SetModeFast()
 
 };
 
@@ -0,0 +1,193 @@
+/*
+  Priority transmit queue, see EBYTE_Queue.h
+*/
+
+#include "EBYTE_Queue.h"
+#include "EBYTE_DutyCycle.h"
+
+/*
+create the queue, entries, frames and statistics are owned by the EBYTETxQueue template
+*/
+EBYTETxQueueBase::EBYTETxQueueBase(EBYTE *radio, EBYTEQueueEntry *entries, uint8_t *data, uint8_t capacity, uint8_t maxFrame,
+								   EBYTEQueueStats *stats, uint8_t levels) {
+	_radio		= radio;
+	_entries	= entries;
+	_data		= data;
+	_capacity	= capacity;
+	_maxFrame	= maxFrame;
+	_stats		= stats;
+	_levels		= levels;
+
+	memset(_stats, 0, levels * sizeof(EBYTEQueueStats));
+	Clear();
+}
+
+void EBYTETxQueueBase::Clear() {
+	for (uint8_t i = 0; i < _capacity; i++) {
+		_entries[i].used = false;
+	}
+}
+
+bool EBYTETxQueueBase::Push(const void *data, uint8_t len, uint8_t priority) {
+
+	int16_t slot	= -1;
+	int16_t victim	= -1;
+
+	if ((len == 0) || (len > _maxFrame) || (priority >= _levels)) {
+		return false;
+	}
+
+	for (uint8_t i = 0; (i < _capacity) && (slot < 0); i++) {
+
+		EBYTEQueueEntry &e = _entries[i];
+
+		if (!e.used) {
+			slot = i;
+		}
+		// the newest unstarted frame of the lowest priority below ours
+		else if ((e.priority > priority) && (e.sent == 0)) {
+			if ((victim < 0) || (e.priority > _entries[victim].priority) ||
+				((e.priority == _entries[victim].priority) && ((uint16_t)(_stamp - e.stamp) < (uint16_t)(_stamp - _entries[victim].stamp)))) {
+				victim = i;
+			}
+		}
+	}
+	if (slot < 0) {
+		if (victim < 0) {
+			return false;
+		}
+		_stats[_entries[victim].priority].Dropped++;
+		slot = victim;
+	}
+
+	EBYTEQueueEntry &e = _entries[slot];
+
+	e.used		= true;
+	e.priority	= priority;
+	e.len		= len;
+	e.sent		= 0;
+	e.stamp		= _stamp++;
+	e.queued	= micros();
+	memcpy(&_data[(uint16_t)slot * _maxFrame], data, len);
+	return true;
+}
+
+uint8_t EBYTETxQueueBase::Pending() {
+
+	uint8_t n = 0;
+
+	for (uint8_t i = 0; i < _capacity; i++) {
+		n += _entries[i].used;
+	}
+	return n;
+}
+
+uint8_t EBYTETxQueueBase::Pending(uint8_t priority) {
+
+	uint8_t n = 0;
+
+	for (uint8_t i = 0; i < _capacity; i++) {
+		n += (_entries[i].used && (_entries[i].priority == priority));
+	}
+	return n;
+}
+
+const EBYTEQueueStats *EBYTETxQueueBase::Stats(uint8_t priority) {
+	return (priority < _levels) ? &_stats[priority] : nullptr;
+}
+
+/*
+method to check the module has sent the last sub packet. AUX can still be high just after a write,
+so the UART time of the last write (and, without AUX, its airtime) must have passed as well
+*/
+bool EBYTETxQueueBase::Ready() {
+
+	uint32_t wait = _radio->UARTTimeMicros(_lastLen) + 2000;
+
+	if (_radio->GetAuxPin() == -1) {
+		wait += _radio->AirTimeMicros(_lastLen);
+	}
+	if ((uint32_t)(micros() - _written) < wait) {
+		return false;
+	}
+	return (_radio->GetAuxPin() == -1) || _radio->GetAux();
+}
+
+/*
+method to pick the frame to send from: highest priority, oldest first
+*/
+int16_t EBYTETxQueueBase::Next() {
+
+	int16_t best = -1;
+
+	for (uint8_t i = 0; i < _capacity; i++) {
+
+		EBYTEQueueEntry &e = _entries[i];
+
+		if (!e.used) {
+			continue;
+		}
+		if ((best < 0) || (e.priority < _entries[best].priority) ||
+			((e.priority == _entries[best].priority) && ((uint16_t)(_stamp - e.stamp) > (uint16_t)(_stamp - _entries[best].stamp)))) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+bool EBYTETxQueueBase::Poll() {
+
+	if (!Ready()) {
+		return Pending() > 0;
+	}
+
+	int16_t i = Next();
+
+	if (i < 0) {
+		return false;
+	}
+
+	EBYTEQueueEntry &e		= _entries[i];
+	uint8_t			chunk	= e.len - e.sent;
+	bool			urgent	= (e.priority == 0);
+	EBYTEDutyCycle	*budget = _radio->GetDutyCycle();
+
+	if (chunk > _radio->GetSubPacketBytes()) {
+		chunk = _radio->GetSubPacketBytes();
+	}
+
+	// out of budget: leave it queued rather than let the budget block or refuse it
+	if (budget && !budget->CanSend(_radio->AirTimeMicros(chunk), urgent)) {
+		return true;
+	}
+
+	uint32_t waited = micros() - e.queued;
+	uint16_t sent	= _radio->SendBytes(&_data[(uint16_t)i * _maxFrame + e.sent], chunk, urgent);
+
+	// refused, tried again. A short write goes on from where it stopped, the bytes written are in the module
+	if (sent == 0) {
+		return true;
+	}
+
+	// counted once the first chunk is out, a refused write is tried again and would count twice
+	if (e.sent == 0) {
+
+		EBYTEQueueStats &s = _stats[e.priority];
+
+		s.Frames++;
+		s.LastDelay = waited;
+		s.AvgDelay	+= (waited - s.AvgDelay) / s.Frames;
+		if (waited > s.MaxDelay) {
+			s.MaxDelay = waited;
+		}
+	}
+
+	_written	= micros();
+	_lastLen	= sent;
+	e.sent		+= sent;
+
+	if (e.sent >= e.len) {
+		e.used = false;
+	}
+	return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+/*
+  Priority transmit queue
+
+  SendStruct waits for the module after every frame, so an alarm raised during a burst of telemetry
+  waits for the whole burst. Frames pushed here go out from Poll() without blocking, one sub packet at
+  a time and only when the module is idle (AUX high), so the module never holds more than the sub
+  packet being sent. Before each sub packet the highest priority frame is picked (0 is highest, first
+  in first out within a priority), so a new alarm waits at most for one sub packet already on air.
+
+  A frame longer than a sub packet goes out in sub packet pieces and a higher priority frame can go
+  between them. Receivers see the pieces as separate packets, so such frames need their own framing.
+
+  When full, a frame pushes out the newest queued frame of a lower priority that has not started.
+  With a duty cycle budget attached (EBYTE::SetDutyCycle) a frame only goes when the budget allows
+  it; priority 0 frames are sent urgent and may use the budget's reserve, so while the budget is low
+  alarms still go and bulk frames wait in the queue instead of blocking.
+
+  Per priority the time from Push() to the first byte written is measured (Stats)
+
+  Usage
+	EBYTETxQueue<> Queue(&Transceiver);					// 3 priorities, 8 frames of up to 200 bytes
+	Queue.Push(&Alarm, sizeof(Alarm), 0);
+	Queue.Push(&Telemetry, sizeof(Telemetry), 2);
+	loop(): Queue.Poll();
+
+  RAM is Capacity * (MaxFrame + 10) bytes plus the stats
+*/
+
+#include "EBYTE_E220.h"
+
+struct EBYTEQueueStats {
+	uint16_t	Frames;				// frames started
+	uint16_t	Dropped;			// frames pushed out by higher priorities
+	uint32_t	LastDelay;			// us from Push() to the first byte written
+	uint32_t	MaxDelay;
+	float		AvgDelay;
+};
+
+struct EBYTEQueueEntry {
+	bool		used;
+	uint8_t		priority;
+	uint8_t		len;
+	uint8_t		sent;				// bytes written so far
+	uint16_t	stamp;				// push order
+	uint32_t	queued;				// micros() of Push()
+};
+
+class EBYTETxQueueBase {
+
+public:
+
+	// method to queue a frame, false if it is too long, the priority is out of range or the queue is
+	// full of frames of the same or higher priority
+	bool		Push(const void *data, uint8_t len, uint8_t priority);
+
+	// method to write the next sub packet if the module is idle, returns true while frames are queued
+	bool		Poll();
+
+	uint8_t		Pending();
+	uint8_t		Pending(uint8_t priority);
+
+	const EBYTEQueueStats *Stats(uint8_t priority);
+
+	// method to drop everything queued, statistics are kept
+	void		Clear();
+
+protected:
+
+	EBYTETxQueueBase(EBYTE *radio, EBYTEQueueEntry *entries, uint8_t *data, uint8_t capacity, uint8_t maxFrame,
+					 EBYTEQueueStats *stats, uint8_t levels);
+
+private:
+
+	bool		Ready();
+	int16_t		Next();
+
+	EBYTE				*_radio;
+	EBYTEQueueEntry		*_entries;
+	uint8_t				*_data;
+	uint8_t				_capacity;
+	uint8_t				_maxFrame;
+	EBYTEQueueStats		*_stats;
+	uint8_t				_levels;
+	uint16_t			_stamp		= 0;
+	uint16_t			_lastLen	= 0;		// bytes of the last write
+	uint32_t			_written	= 0;		// micros() of the last write
+
+};
+
+template <uint8_t Levels = 3, uint8_t Capacity = 8, uint8_t MaxFrame = 200>
+class EBYTETxQueue : public EBYTETxQueueBase {
+
+public:
+
+	EBYTETxQueue(EBYTE *radio) : EBYTETxQueueBase(radio, _entryTable, _frameData, Capacity, MaxFrame, _statTable, Levels) {}
+
+private:
+
+	EBYTEQueueEntry		_entryTable[Capacity];
+	EBYTEQueueStats		_statTable[Levels];
+	uint8_t				_frameData[Capacity * MaxFrame];
+
+};
@@ -0,0 +1,352 @@
+/*
+  Store and forward relay / mesh routing, see EBYTE_Router.h
+*/
+
+#include "EBYTE_Router.h"
+
+// queue slot layout
+#define SLOT_FLAGS		0
+#define SLOT_STAMP		1
+#define SLOT_LEN		2
+#define SLOT_ADDH		3		// ADDH, ADDL, CHAN and the frame are written to the module in one go
+#define SLOT_FRAME		6
+
+#define SLOT_USED		0x01
+#define SLOT_LOCAL		0x02
+
+/*
+create the router, the tables are owned by the EBYTERouter template
+*/
+EBYTERouterBase::EBYTERouterBase(EBYTE *radio, EBYTERoute *routes, uint8_t maxRoutes, EBYTENeighbour *neighbours, uint8_t maxNeighbours,
+								 EBYTEDedupBase *dedup, uint8_t *slots, uint8_t maxSlots, uint8_t maxPayload) {
+	_radio			= radio;
+	_routes			= routes;
+	_maxRoutes		= maxRoutes;
+	_neighbours		= neighbours;
+	_maxNeighbours	= maxNeighbours;
+	_dedup			= dedup;
+	_slots			= slots;
+	_maxSlots		= maxSlots;
+	_maxPayload		= maxPayload;
+}
+
+void EBYTERouterBase::Begin(ebyteReceiveFunc receive) {
+
+	_receive		= receive;
+	_address		= _radio->GetAddress();
+	_chan			= _radio->GetChannel();
+	_routeCount		= 0;
+	_neighbourCount = 0;
+	_lastHello		= millis();
+
+	_dedup->Clear();
+	for (uint8_t i = 0; i <= _maxSlots; i++) {
+		Slot(i)[SLOT_FLAGS] = 0;
+	}
+}
+
+bool EBYTERouterBase::AddRoute(uint16_t dst, uint16_t via, uint8_t chan) {
+
+	uint8_t i = 0;
+
+	while ((i < _routeCount) && (_routes[i].dst != dst)) {
+		i++;
+	}
+	if (i == _routeCount) {
+		if (_routeCount >= _maxRoutes) {
+			return false;
+		}
+		_routeCount++;
+	}
+	_routes[i].dst	= dst;
+	_routes[i].via	= via;
+	_routes[i].chan = chan;
+	return true;
+}
+
+bool EBYTERouterBase::RemoveRoute(uint16_t dst) {
+
+	for (uint8_t i = 0; i < _routeCount; i++) {
+		if (_routes[i].dst == dst) {
+			_routes[i] = _routes[--_routeCount];
+			return true;
+		}
+	}
+	return false;
+}
+
+void EBYTERouterBase::SetHelloInterval(unsigned long interval) {
+	_helloInterval = interval;
+}
+
+uint8_t EBYTERouterBase::Neighbours() {
+	return _neighbourCount;
+}
+
+const EBYTENeighbour *EBYTERouterBase::Neighbour(uint8_t i) {
+	return (i < _neighbourCount) ? &_neighbours[i] : nullptr;
+}
+
+uint8_t *EBYTERouterBase::Slot(uint8_t i) {
+	return _slots + (uint16_t)i * (SLOT_FRAME + EBYTE_ROUTE_HEADER + _maxPayload);
+}
+
+/*
+method to find the next hop: static route, then a neighbour, then the default route
+*/
+bool EBYTERouterBase::Lookup(uint16_t dst, uint16_t &to, uint8_t &chan) {
+
+	if (dst == EBYTE_ROUTE_BROADCAST) {
+		to		= EBYTE_ROUTE_BROADCAST;
+		chan	= _chan;
+		return true;
+	}
+	for (uint8_t i = 0; i < _routeCount; i++) {
+		if (_routes[i].dst == dst) {
+			to		= _routes[i].via;
+			chan	= _routes[i].chan;
+			return true;
+		}
+	}
+	for (uint8_t i = 0; i < _neighbourCount; i++) {
+		if (_neighbours[i].address == dst) {
+			to		= dst;
+			chan	= _neighbours[i].chan;
+			return true;
+		}
+	}
+	for (uint8_t i = 0; i < _routeCount; i++) {
+		if (_routes[i].dst == EBYTE_ROUTE_DEFAULT) {
+			to		= _routes[i].via;
+			chan	= _routes[i].chan;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+method to take a free queue slot, returns where the frame goes or nullptr if the queue is full
+*/
+uint8_t *EBYTERouterBase::Enqueue(uint16_t to, uint8_t chan, uint8_t len, bool local) {
+
+	for (uint8_t i = 0; i < _maxSlots; i++) {
+
+		uint8_t *slot = Slot(i);
+
+		if (!(slot[SLOT_FLAGS] & SLOT_USED)) {
+			slot[SLOT_FLAGS]	= SLOT_USED | (local ? SLOT_LOCAL : 0);
+			slot[SLOT_STAMP]	= _stamp++;
+			slot[SLOT_LEN]		= len;
+			slot[SLOT_ADDH]		= (uint8_t)(to >> 8);
+			slot[SLOT_ADDH + 1] = (uint8_t)to;
+			slot[SLOT_ADDH + 2] = chan;
+			return &slot[SLOT_FRAME];
+		}
+	}
+	QueueFull++;
+	return nullptr;
+}
+
+bool EBYTERouterBase::Send(uint16_t dst, const void *data, uint8_t len) {
+
+	uint8_t		*frame;
+	uint16_t	to;
+	uint8_t		chan;
+
+	if ((len > _maxPayload) || ((3 + EBYTE_ROUTE_HEADER + len) > _radio->GetSubPacketBytes())) {
+		return false;
+	}
+	if (!Lookup(dst, to, chan)) {
+		NoRoute++;
+		return false;
+	}
+	frame = Enqueue(to, chan, EBYTE_ROUTE_HEADER + len, true);
+	if (!frame) {
+		return false;
+	}
+
+	_seq++;
+
+	frame[0] = EBYTE_ROUTE_MAGIC;
+	frame[1] = EBYTE_ROUTE_DATA;
+	frame[2] = (uint8_t)(_address >> 8);
+	frame[3] = (uint8_t)_address;
+	frame[4] = (uint8_t)(dst >> 8);
+	frame[5] = (uint8_t)dst;
+	frame[6] = _seq;
+	frame[7] = 0;
+	frame[8] = len;
+	memcpy(&frame[EBYTE_ROUTE_HEADER], data, len);
+
+	return true;
+}
+
+void EBYTERouterBase::SendHello() {
+
+	const uint8_t hello[EBYTE_ROUTE_HEADER + 1] = {
+		EBYTE_ROUTE_MAGIC, EBYTE_ROUTE_HELLO, (uint8_t)(_address >> 8), (uint8_t)_address,
+		0xFF, 0xFF, 0, 0, 1, _chan
+	};
+	uint8_t *frame = Enqueue(EBYTE_ROUTE_BROADCAST, _chan, sizeof(hello), true);
+
+	if (frame) {
+		memcpy(frame, hello, sizeof(hello));
+	}
+}
+
+void EBYTERouterBase::UpdateNeighbour(uint16_t address, uint8_t chan, uint8_t rssi) {
+
+	uint8_t i = 0;
+
+	while ((i < _neighbourCount) && (_neighbours[i].address != address)) {
+		i++;
+	}
+	if (i == _neighbourCount) {
+		if (_neighbourCount < _maxNeighbours) {
+			_neighbourCount++;
+		}
+		else {
+			// table full, replace the one heard longest ago
+			i = 0;
+			for (uint8_t j = 1; j < _neighbourCount; j++) {
+				if ((millis() - _neighbours[j].seen) > (millis() - _neighbours[i].seen)) {
+					i = j;
+				}
+			}
+		}
+	}
+	_neighbours[i].address	= address;
+	_neighbours[i].chan		= chan;
+	_neighbours[i].rssi		= rssi;
+	_neighbours[i].seen		= millis();
+}
+
+/*
+method to read one frame into the receive slot and deliver, forward or drop it
+*/
+void EBYTERouterBase::Receive() {
+
+	uint8_t *frame = Slot(_maxSlots) + SLOT_FRAME;
+
+	if (!_radio->available()) {
+		return;
+	}
+	// whatever is left of a frame that can't be read is dropped, or it is taken for the next header
+	if ((_radio->GetBytes(frame, EBYTE_ROUTE_HEADER) != EBYTE_ROUTE_HEADER) ||
+		(frame[0] != EBYTE_ROUTE_MAGIC) || (frame[8] > _maxPayload) ||
+		!_radio->GetStruct(&frame[EBYTE_ROUTE_HEADER], frame[8])) {
+		_radio->DropPacket();
+		return;
+	}
+
+	uint16_t	src		= (frame[2] << 8) | frame[3];
+	uint16_t	dst		= (frame[4] << 8) | frame[5];
+	uint8_t		hops	= frame[7];
+	uint8_t		len		= frame[8];
+	uint8_t		*data	= &frame[EBYTE_ROUTE_HEADER];
+	uint16_t	to;
+	uint8_t		chan;
+
+	if (frame[1] == EBYTE_ROUTE_HELLO) {
+		if (len >= 1) {
+			UpdateNeighbour(src, data[0], _radio->newRSSIdataAvailable ? _radio->RSSIdata : 0);
+		}
+		return;
+	}
+	if (frame[1] != EBYTE_ROUTE_DATA) {
+		return;
+	}
+	if ((src == _address) || _dedup->Seen(src, frame[6])) {
+		Duplicates++;
+		return;
+	}
+
+	if ((dst == _address) || (dst == EBYTE_ROUTE_BROADCAST)) {
+		Delivered++;
+		if (_receive) {
+			_receive(src, data, len);
+		}
+		if (dst == _address) {
+			return;
+		}
+	}
+
+	if ((hops + 1) >= MaxHops) {
+		HopLimit++;
+		return;
+	}
+	if (!Lookup(dst, to, chan)) {
+		NoRoute++;
+		return;
+	}
+
+	uint8_t *out = Enqueue(to, chan, EBYTE_ROUTE_HEADER + len, false);
+
+	if (out) {
+		memcpy(out, frame, EBYTE_ROUTE_HEADER + len);
+		out[7] = hops + 1;
+		Forwarded++;
+	}
+}
+
+/*
+method to write the next queued frame if the module is idle: local frames first, oldest first
+*/
+void EBYTERouterBase::Transmit() {
+
+	uint8_t *best = nullptr;
+	uint8_t age	  = 0;
+
+	if (!_radio->GetAux() || ((micros() - _written) < (_radio->UARTTimeMicros(_lastLen) + 2000))) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < _maxSlots; i++) {
+
+		uint8_t *slot = Slot(i);
+		uint8_t a	  = _stamp - slot[SLOT_STAMP];
+
+		if (!(slot[SLOT_FLAGS] & SLOT_USED)) {
+			continue;
+		}
+		if (!best || ((slot[SLOT_FLAGS] & SLOT_LOCAL) > (best[SLOT_FLAGS] & SLOT_LOCAL)) ||
+			(((slot[SLOT_FLAGS] & SLOT_LOCAL) == (best[SLOT_FLAGS] & SLOT_LOCAL)) && (a > age))) {
+			best	= slot;
+			age		= a;
+		}
+	}
+	if (!best) {
+		return;
+	}
+
+	_lastLen = 3 + best[SLOT_LEN];
+
+	// refused by the duty cycle budget: it stays queued for the next Poll(). A frame written in part has
+	// been charged and is in the module, written again it would go out twice
+	if (_radio->SendBytes(&best[SLOT_ADDH], _lastLen) == 0) {
+		Refused++;
+		return;
+	}
+	_written = micros();
+	best[SLOT_FLAGS] = 0;
+}
+
+void EBYTERouterBase::Poll() {
+
+	Receive();
+
+	if (_helloInterval) {
+		if ((millis() - _lastHello) >= _helloInterval) {
+			_lastHello = millis();
+			SendHello();
+		}
+		for (uint8_t i = 0; i < _neighbourCount; i++) {
+			if ((millis() - _neighbours[i].seen) > (3 * _helloInterval)) {
+				_neighbours[i--] = _neighbours[--_neighbourCount];
+			}
+		}
+	}
+
+	Transmit();
+}
@@ -0,0 +1,154 @@
+#pragma once
+/*
+  Store and forward relay / mesh routing on top of fixed transmission mode
+
+  In fixed mode every packet written to the module starts with ADDH, ADDL and CHAN of the module it is
+  for, so a relay can pass a frame on to the next hop on another channel. Each node runs an EBYTERouter.
+  Frames carry the original source and final destination, a sequence number and a hop count:
+
+	[0x5A][type][src hi][src lo][dst hi][dst lo][seq][hops][length][data]
+
+  The next hop for a destination comes from, in order, the static routing table (AddRoute), the
+  neighbour table (nodes heard directly, learnt from HELLO broadcasts, with the RSSI byte of the last
+  one if EnableRSSIByte is on) or the default route (AddRoute(EBYTE_ROUTE_DEFAULT, ...)).
+  Frames already seen (same source and sequence, see EBYTE_Dedup.h) are dropped, frames over MaxHops
+  are dropped.
+  Broadcasts (EBYTE_ROUTE_BROADCAST) are delivered and flooded to neighbours on our channel.
+
+  Send() and forwarding only queue frames, Poll() does the radio work: it reads one frame if one is
+  waiting and writes one queued frame if the module is idle. Local frames are written before frames
+  being forwarded, so relaying never holds up the node's own traffic. Reading a frame waits for the
+  rest of it to arrive and for AUX (GetStruct), writing never waits for the module.
+
+  The module must be in fixed mode: SetTransmissionMode(FixedModeENABLE) and SaveParameters()
+  Each node needs its own address, own channel is where it listens.
+
+  Usage
+	EBYTERouter<> Router(&Transceiver);
+	void OnFrame(uint16_t src, const uint8_t *data, uint8_t len) { ... }
+	setup():	Router.Begin(OnFrame);
+				Router.AddRoute(EBYTE_ROUTE_DEFAULT, 0x0001, 15);		// gateway 0x0001 on channel 15
+	loop():		Router.Poll();
+				Router.Send(0x0001, &MyData, sizeof(MyData));
+
+  RAM is fixed by the template: MaxPayload sized frame slots for QueueSize frames (+1 for receiving),
+  RouteSize routes, NeighbourSize neighbours and SourceSize sources for duplicates
+*/
+
+#include "EBYTE_E220.h"
+#include "EBYTE_Dedup.h"
+
+#define EBYTE_ROUTE_MAGIC		0x5A
+#define EBYTE_ROUTE_DATA		0x01
+#define EBYTE_ROUTE_HELLO		0x02
+
+#define EBYTE_ROUTE_HEADER		9
+#define EBYTE_ROUTE_BROADCAST	0xFFFF
+#define EBYTE_ROUTE_DEFAULT		0xFFFF		// as destination in AddRoute, route for everything else
+#define EBYTE_ROUTE_MAX_HOPS	4
+
+struct EBYTERoute {
+	uint16_t	dst;
+	uint16_t	via;
+	uint8_t		chan;
+};
+
+struct EBYTENeighbour {
+	uint16_t		address;
+	uint8_t			chan;
+	uint8_t			rssi;		// RSSI byte of the last HELLO, 0 if EnableRSSIByte is off
+	unsigned long	seen;		// millis() of the last HELLO
+};
+
+class EBYTERouterBase {
+
+public:
+
+	// method to start routing, the node's address and channel are taken from the EBYTE object
+	void	Begin(ebyteReceiveFunc receive);
+
+	// methods to manage the static routing table, false if full / not found
+	bool	AddRoute(uint16_t dst, uint16_t via, uint8_t chan);
+	bool	RemoveRoute(uint16_t dst);
+
+	// method to queue a frame for dst, false if it is too long, there is no route or the queue is full
+	bool	Send(uint16_t dst, const void *data, uint8_t len);
+
+	// method to do the radio work, call from loop()
+	void	Poll();
+
+	// HELLO broadcasts, 0 turns them off. Neighbours not heard for 3 intervals are forgotten
+	void	SetHelloInterval(unsigned long interval);
+
+	uint8_t					Neighbours();
+	const EBYTENeighbour	*Neighbour(uint8_t i);
+
+	uint8_t		MaxHops		= EBYTE_ROUTE_MAX_HOPS;
+
+	uint16_t	Delivered	= 0;		// frames passed to the receive function
+	uint16_t	Forwarded	= 0;		// frames queued for the next hop
+	uint16_t	Duplicates	= 0;		// frames dropped as already seen
+	uint16_t	NoRoute		= 0;		// frames dropped for lack of a next hop
+	uint16_t	QueueFull	= 0;		// frames dropped because the queue was full
+	uint16_t	HopLimit	= 0;		// frames dropped at MaxHops
+	uint16_t	Refused		= 0;		// sends refused by the duty cycle budget, the frame kept queued
+
+protected:
+
+	EBYTERouterBase(EBYTE *radio, EBYTERoute *routes, uint8_t maxRoutes, EBYTENeighbour *neighbours, uint8_t maxNeighbours,
+					EBYTEDedupBase *dedup, uint8_t *slots, uint8_t maxSlots, uint8_t maxPayload);
+
+private:
+
+	bool		Lookup(uint16_t dst, uint16_t &to, uint8_t &chan);
+	uint8_t		*Slot(uint8_t i);
+	uint8_t		*Enqueue(uint16_t to, uint8_t chan, uint8_t len, bool local);
+	void		Receive();
+	void		Transmit();
+	void		SendHello();
+	void		UpdateNeighbour(uint16_t address, uint8_t chan, uint8_t rssi);
+
+	EBYTE				*_radio;
+	EBYTERoute			*_routes;
+	EBYTENeighbour		*_neighbours;
+	EBYTEDedupBase		*_dedup;
+	uint8_t				*_slots;
+	uint8_t				_maxRoutes;
+	uint8_t				_maxNeighbours;
+	uint8_t				_maxSlots;				// queue slots, the slot after the last is for receiving
+	uint8_t				_maxPayload;
+	uint8_t				_routeCount		= 0;
+	uint8_t				_neighbourCount	= 0;
+	uint8_t				_seq			= 0;
+	uint8_t				_stamp			= 0;
+	uint16_t			_address		= 0;
+	uint8_t				_chan			= 0;
+	uint16_t			_lastLen		= 0;
+	unsigned long		_written		= 0;
+	unsigned long		_helloInterval	= 0;
+	unsigned long		_lastHello		= 0;
+	ebyteReceiveFunc	_receive		= nullptr;
+
+};
+
+template <uint8_t MaxPayload = 32, uint8_t QueueSize = 4, uint8_t RouteSize = 8, uint8_t NeighbourSize = 8, uint8_t SourceSize = 16>
+class EBYTERouter : public EBYTERouterBase {
+
+	static_assert(MaxPayload + EBYTE_ROUTE_HEADER + 3 <= 200, "EBYTERouter: frame must fit a 200 byte sub packet");
+
+public:
+
+	EBYTERouter(EBYTE *radio) : EBYTERouterBase(radio, _routeTable, RouteSize, _neighbourTable, NeighbourSize,
+												&_dedupCache, _slotData, QueueSize, MaxPayload) {}
+
+	// each slot: flags, stamp, frame length, ADDH, ADDL, CHAN, frame
+	static const uint8_t SlotSize = 6 + EBYTE_ROUTE_HEADER + MaxPayload;
+
+private:
+
+	EBYTERoute		_routeTable[RouteSize];
+	EBYTENeighbour	_neighbourTable[NeighbourSize];
+	EBYTEDedup<SourceSize>	_dedupCache;
+	uint8_t			_slotData[(QueueSize + 1) * SlotSize];
+
+};
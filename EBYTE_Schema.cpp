@@ -0,0 +1,221 @@
+/*
+  Bit packed schema codec, see EBYTE_Schema.h
+*/
+
+#include "EBYTE_Schema.h"
+
+/*
+helpers to write/read a value LSB first at a bit position of the packed buffer
+*/
+static void PutBits(uint8_t *packed, uint16_t &pos, uint32_t val, uint8_t bits) {
+
+	for (uint8_t i = 0; i < bits; i++, pos++) {
+		if (val & ((uint32_t)1 << i)) {
+			packed[pos >> 3] |= (uint8_t)(1 << (pos & 7));
+		}
+	}
+}
+
+static uint32_t GetBits(const uint8_t *packed, uint16_t &pos, uint8_t bits) {
+
+	uint32_t val = 0;
+
+	for (uint8_t i = 0; i < bits; i++, pos++) {
+		if (packed[pos >> 3] & (1 << (pos & 7))) {
+			val |= ((uint32_t)1 << i);
+		}
+	}
+	return val;
+}
+
+static uint32_t MaxValue(uint8_t bits) {
+	return (bits >= 32) ? 0xFFFFFFFF : (((uint32_t)1 << bits) - 1);
+}
+
+EBYTESchema::EBYTESchema(const EBYTEField *fields, uint8_t count) {
+
+	uint16_t bits = 0;
+
+	_fields = fields;
+	_count	= count;
+
+	for (uint8_t i = 0; i < count; i++) {
+		bits += fields[i].bits;
+	}
+	_size = (bits + 7) >> 3;
+}
+
+uint8_t EBYTESchema::PackedSize() {
+	return _size;
+}
+
+/*
+method to pack a struct, the packed buffer must hold PackedSize() bytes
+*/
+uint8_t EBYTESchema::Pack(const void *TheStructure, uint8_t *packed) {
+
+	uint16_t pos = 0;
+
+	memset(packed, 0, _size);
+
+	for (uint8_t i = 0; i < _count; i++) {
+
+		const EBYTEField	&f		= _fields[i];
+		const uint8_t		*member = (const uint8_t *)TheStructure + f.offset;
+		uint8_t				size	= f.type & 0x0F;
+		uint32_t			max		= MaxValue(f.bits);
+		uint32_t			val;
+
+		if (f.type & EBYTE_FIELD_FLOAT) {
+			double v;
+
+			if (size == sizeof(float)) {
+				float fv;
+				memcpy(&fv, member, sizeof(fv));
+				v = fv;
+			}
+			else {
+				memcpy(&v, member, sizeof(v));
+			}
+			v = (v - f.min) * f.scale;
+
+			if (!(v > 0)) {						// also catches NaN
+				val = 0;
+			}
+			else if (v >= (double)max) {
+				val = max;
+			}
+			else {
+				val = (uint32_t)(v + 0.5);
+			}
+		}
+		else if (f.type & EBYTE_FIELD_SIGNED) {
+			int64_t sv;
+
+			if (size == 1) {
+				int8_t	t;	memcpy(&t, member, 1);	sv = t;
+			}
+			else if (size == 2) {
+				int16_t t;	memcpy(&t, member, 2);	sv = t;
+			}
+			else if (size == 4) {
+				int32_t t;	memcpy(&t, member, 4);	sv = t;
+			}
+			else {
+				memcpy(&sv, member, 8);
+			}
+
+			// clamped to the width, 64 bit members too
+			int64_t hi = (int64_t)(max >> 1);
+			int64_t lo = -hi - 1;
+
+			if (sv > hi) {
+				sv = hi;
+			}
+			else if (sv < lo) {
+				sv = lo;
+			}
+			val = (uint32_t)sv & max;
+		}
+		else {
+			uint64_t uv;
+
+			if (size == 1) {
+				uint8_t	 t; memcpy(&t, member, 1);	uv = t;
+			}
+			else if (size == 2) {
+				uint16_t t; memcpy(&t, member, 2);	uv = t;
+			}
+			else if (size == 4) {
+				uint32_t t; memcpy(&t, member, 4);	uv = t;
+			}
+			else {
+				memcpy(&uv, member, 8);
+			}
+			val = (uv > max) ? max : (uint32_t)uv;
+		}
+		PutBits(packed, pos, val, f.bits);
+	}
+	return _size;
+}
+
+/*
+method to unpack into a struct, members not in the schema are left alone
+*/
+void EBYTESchema::Unpack(const uint8_t *packed, void *TheStructure) {
+
+	uint16_t pos = 0;
+
+	for (uint8_t i = 0; i < _count; i++) {
+
+		const EBYTEField	&f		= _fields[i];
+		uint8_t				*member = (uint8_t *)TheStructure + f.offset;
+		uint8_t				size	= f.type & 0x0F;
+		uint32_t			val		= GetBits(packed, pos, f.bits);
+
+		if (f.type & EBYTE_FIELD_FLOAT) {
+			double v = (double)val / f.scale + f.min;
+
+			if (size == sizeof(float)) {
+				float fv = (float)v;
+				memcpy(member, &fv, sizeof(fv));
+			}
+			else {
+				memcpy(member, &v, sizeof(v));
+			}
+			continue;
+		}
+
+		// sign extend signed fields narrower than 32 bits
+		if ((f.type & EBYTE_FIELD_SIGNED) && (f.bits < 32) && (val & ((uint32_t)1 << (f.bits - 1)))) {
+			val |= ~MaxValue(f.bits);
+		}
+
+		if (size == 1) {
+			uint8_t	 t = (uint8_t)val;	memcpy(member, &t, 1);
+		}
+		else if (size == 2) {
+			uint16_t t = (uint16_t)val; memcpy(member, &t, 2);
+		}
+		else if (size == 4) {
+			memcpy(member, &val, 4);
+		}
+		else {
+			int64_t t = (f.type & EBYTE_FIELD_SIGNED) ? (int64_t)(int32_t)val : (int64_t)val;
+			memcpy(member, &t, sizeof(t));
+		}
+	}
+}
+
+/*
+method to send a struct packed, false if it doesn't fit EBYTE_SCHEMA_MAX_BYTES or the sub packet
+*/
+bool EBYTESchema::Send(EBYTE &radio, const void *TheStructure) {
+
+	uint8_t packed[EBYTE_SCHEMA_MAX_BYTES];
+
+	if ((_size > sizeof(packed)) || (_size > radio.GetSubPacketBytes())) {
+		return false;
+	}
+	Pack(TheStructure, packed);
+
+	return radio.SendStruct(packed, _size);
+}
+
+/*
+method to receive a packed struct, the struct is only changed if a whole packet arrived
+*/
+bool EBYTESchema::Get(EBYTE &radio, void *TheStructure) {
+
+	uint8_t packed[EBYTE_SCHEMA_MAX_BYTES];
+
+	if (_size > sizeof(packed)) {
+		return false;
+	}
+	if (!radio.GetStruct(packed, _size)) {
+		return false;
+	}
+	Unpack(packed, TheStructure);
+
+	return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+/*
+  Bit packed schema codec for SendStruct/GetStruct
+
+  Sending a raw struct between a Teensy and an Arduino breaks because each MCU pads and sizes types
+  differently, and the padding and full width fields cost airtime. A schema lists the fields of a
+  struct with the number of bits each one needs on air. Pack() writes them one after the other, least
+  significant bit first, into little endian bytes, so every MCU produces and decodes the same bytes.
+
+  Integer fields are sent as is (two's complement if the member is signed) and saturate if they don't
+  fit their width, 64 bit members included. Float fields are sent fixed point, (value - Min) * Scale rounded, as an unsigned
+  number clamped to the width. Widths are 1 to 32 bits.
+
+  Usage, in a .h file included by both sketches
+	struct DATA {
+		unsigned long	Count;
+		int				Bits;
+		float			Volts;
+		float			Amps;
+	};
+
+	const EBYTEField DataFields[] = {
+		EBYTE_FIELD(DATA, Count, 16),				// saturates at 65535
+		EBYTE_FIELD(DATA, Bits, 11),				// int is signed, analogRead() is 0..1023
+		EBYTE_FIXED(DATA, Volts, 9, 100, 0),		// 0.00 .. 5.11 V
+		EBYTE_FIXED(DATA, Amps, 10, 100, -5),		// -5.00 .. 5.23 A
+	};
+	EBYTESchema DataSchema(DataFields, EBYTE_FIELDS(DataFields));
+
+  then DataSchema.Send(Transceiver, &MyData) and DataSchema.Get(Transceiver, &MyData)
+  here 6 bytes go on air instead of 16 (Teensy) or 14 (Arduino)
+*/
+
+#include "EBYTE_E220.h"
+
+// largest packed struct, the packed bytes are built on the stack
+#ifndef EBYTE_SCHEMA_MAX_BYTES
+#if defined(__AVR__)
+#define EBYTE_SCHEMA_MAX_BYTES 64
+#else
+#define EBYTE_SCHEMA_MAX_BYTES 200
+#endif
+#endif
+
+// field type: low nibble is the size of the member in bytes
+#define EBYTE_FIELD_SIGNED	0x10
+#define EBYTE_FIELD_FLOAT	0x20
+
+struct EBYTEField {
+	uint16_t	offset;		// offsetof() the member
+	uint8_t		type;		// member size | EBYTE_FIELD_SIGNED | EBYTE_FIELD_FLOAT
+	uint8_t		bits;		// width on air
+	float		scale;		// float fields only
+	float		min;		// float fields only
+};
+
+// works out the field type from the member type, without <type_traits> so it builds on AVR
+template <typename T>
+struct EBYTEFieldType {
+	static const uint8_t value = (((T)(-1) < (T)0) ? EBYTE_FIELD_SIGNED : 0) | sizeof(T);
+};
+template <>
+struct EBYTEFieldType<float> {
+	static const uint8_t value = EBYTE_FIELD_FLOAT | sizeof(float);
+};
+template <>
+struct EBYTEFieldType<double> {
+	static const uint8_t value = EBYTE_FIELD_FLOAT | sizeof(double);
+};
+
+template <uint8_t Bits>
+struct EBYTEFieldBits {
+	static_assert((Bits >= 1) && (Bits <= 32), "schema fields are 1 to 32 bits wide");
+	static const uint8_t value = Bits;
+};
+
+#define EBYTE_MEMBER_TYPE(Struct, Member)	EBYTEFieldType<decltype(((Struct *)0)->Member)>::value
+
+#define EBYTE_FIELD(Struct, Member, Bits) \
+	{ offsetof(Struct, Member), EBYTE_MEMBER_TYPE(Struct, Member), EBYTEFieldBits<Bits>::value, 1, 0 }
+
+#define EBYTE_FIXED(Struct, Member, Bits, Scale, Min) \
+	{ offsetof(Struct, Member), EBYTE_MEMBER_TYPE(Struct, Member), EBYTEFieldBits<Bits>::value, (Scale), (Min) }
+
+#define EBYTE_FIELDS(Fields)	((uint8_t)(sizeof(Fields) / sizeof(Fields[0])))
+
+class EBYTESchema {
+
+public:
+
+	EBYTESchema(const EBYTEField *fields, uint8_t count);
+
+	// bytes on air for one packed struct
+	uint8_t PackedSize();
+
+	// methods to convert between the struct and its packed bytes, Pack returns the packed size
+	uint8_t Pack(const void *TheStructure, uint8_t *packed);
+	void	Unpack(const uint8_t *packed, void *TheStructure);
+
+	// methods to send and receive a packed struct through SendStruct/GetStruct
+	bool	Send(EBYTE &radio, const void *TheStructure);
+	bool	Get(EBYTE &radio, void *TheStructure);
+
+private:
+
+	const EBYTEField	*_fields;
+	uint8_t				_count;
+	uint8_t				_size;
+
+};
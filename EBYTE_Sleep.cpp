@@ -0,0 +1,187 @@
+/*
+  Sleep scheduler, see EBYTE_Sleep.h
+*/
+
+#include "EBYTE_Sleep.h"
+
+EBYTESleep::EBYTESleep(EBYTE *radio) {
+	_radio = radio;
+}
+
+void EBYTESleep::Begin(unsigned long period, unsigned long window, MODE_TYPE awakeMode) {
+
+	_period		= period ? period : 1;
+	_window		= window;
+	_awakeMode	= awakeMode;
+	_running	= true;
+	_awakeTotal	= 0;
+
+	// statistics start again with the schedule
+	Cycles		= 0;
+	Early		= 0;
+	Late		= 0;
+	Failures	= 0;
+	MaxLatency	= 0;
+	LastAwake	= 0;
+	AvgAwake	= 0;
+
+	// the module is awake from being set up, that is the first window
+	_radio->SetMode(_awakeMode);
+	_started	= millis();
+	_woken		= _started;
+	_opened		= _started;
+	_next		= _started + _period;
+	_awake		= true;
+	Cycles++;
+}
+
+void EBYTESleep::End() {
+
+	if (_running && !_awake) {
+		_radio->SetModeFast(_awakeMode);
+	}
+	_running	= false;
+	_awake		= false;
+}
+
+bool EBYTESleep::Awake() {
+	return _awake;
+}
+
+void EBYTESleep::Post() {
+	if (_pending < 255) {
+		_pending++;
+	}
+}
+
+void EBYTESleep::Done() {
+	if (_pending) {
+		_pending--;
+	}
+}
+
+uint8_t EBYTESleep::Pending() {
+	return _pending;
+}
+
+void EBYTESleep::SetBatch(uint8_t n) {
+	_batch = n;
+}
+
+uint32_t EBYTESleep::WakeLatency() {
+	return _lead;
+}
+
+unsigned long EBYTESleep::SleepMillis() {
+
+	if (!_running || _awake) {
+		return 0;
+	}
+	if (_batch && (_pending >= _batch)) {
+		return 0;
+	}
+
+	unsigned long lead = (_lead + 999) / 1000;
+	unsigned long left = _next - millis();
+
+	// past the wake time already (the difference wrapped)
+	if ((long)left <= (long)lead) {
+		return 0;
+	}
+	return left - lead;
+}
+
+float EBYTESleep::AwakePercent() {
+
+	unsigned long total = millis() - _started;
+
+	if (total == 0) {
+		return 100.0f;
+	}
+	return 100.0f * (float)(_awakeTotal + (_awake ? (millis() - _woken) : 0)) / (float)total;
+}
+
+bool EBYTESleep::Poll() {
+
+	if (!_running) {
+		return false;
+	}
+
+	unsigned long now = millis();
+
+	if (_awake) {
+
+		bool ready		= (_radio->GetAuxPin() == -1) || _radio->GetAux();
+		bool idle		= ready && !_radio->available();
+		unsigned long open	= ((long)(now - _opened) > 0) ? (now - _opened) : 0;
+
+		// stay up for the window and the work batched into it, but never past MaxWindow
+		if (((open >= _window) && (_pending == 0) && idle) || ((open >= MaxWindow) && ready)) {
+			Sleep();
+		}
+	}
+	else if (_batch && (_pending >= _batch)) {
+		Wake(true);
+	}
+	else if ((long)(now - (_next - (_lead + 999) / 1000)) >= 0) {
+		Wake(false);
+	}
+	return _awake;
+}
+
+/*
+method to wake the module, ahead of the window at _next or straight away for a batch
+*/
+void EBYTESleep::Wake(bool early) {
+
+	_woken = millis();
+
+	if (!_radio->SetModeFast(_awakeMode)) {
+		Failures++;
+	}
+
+	// wake ahead by the slowest wake seen, letting it come down slowly if the module got faster
+	LastLatency = _radio->GetModeLatency();
+	if (LastLatency > MaxLatency) {
+		MaxLatency = LastLatency;
+	}
+	if (LastLatency > _lead) {
+		_lead = LastLatency;
+	}
+	else {
+		_lead -= (_lead - LastLatency) / 8;
+	}
+
+	unsigned long now = millis();
+
+	if (early) {
+		Early++;
+	}
+	else if ((long)(now - _next) > 0) {
+		Late++;
+	}
+	// a scheduled window starts at _next however early the wake ahead finished, or it would close early
+	_opened	= (!early && ((long)(_next - now) > 0)) ? _next : now;
+	_awake	= true;
+	Cycles++;
+
+	// move on to the next window that doesn't start inside this one, skipping any missed
+	if (!early) {
+		_next += _period;
+	}
+	while ((long)(_opened + _window - _next) >= 0) {
+		_next += _period;
+	}
+}
+
+void EBYTESleep::Sleep() {
+
+	if (!_radio->SetModeFast(MODE_DEEPSLEEP)) {
+		Failures++;
+	}
+
+	LastAwake	= millis() - _woken;
+	_awakeTotal	+= LastAwake;
+	AvgAwake	+= ((float)LastAwake - AvgAwake) / (float)Cycles;
+	_awake		= false;
+}
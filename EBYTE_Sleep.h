@@ -0,0 +1,98 @@
+#pragma once
+/*
+  Sleep scheduler: keeping the module in deep sleep between windows
+
+  The module draws a few uA in deep sleep and mA awake, so on battery it should be awake only when
+  there is something to send or a peer is known to be sending. The scheduler opens an awake window
+  every period and keeps the module asleep in between. Work queued while asleep (Post) is batched
+  into the next window, which stays open until all of it is Done or MaxWindow runs out. With
+  SetBatch(n), n pieces of work waiting open a window straight away instead of at the next period.
+
+  Waking goes through EBYTE::SetModeFast(), which skips SetMode's fixed delays and measures the time
+  from the pins changing to AUX going high. The scheduler wakes the module that long (the largest seen,
+  slowly decaying) before each window, so the module is ready when the window starts. A window that
+  started before the module was ready counts as Late.
+
+  Nothing is received while asleep. Peers must send inside the windows, so put every node on the same
+  schedule (EBYTETimeSync) or make the gateway wake them with WOR.
+
+  Usage
+	EBYTESleep Sleep(&Transceiver);
+	setup():	Sleep.Begin(10000, 50);				// 50ms window every 10s
+	loop():		if (Sleep.Poll()) { send what is queued, read what came in, Sleep.Done() per item }
+				else { put the MCU to sleep for up to Sleep.SleepMillis() }
+	anywhere:	queue a reading, then Sleep.Post()
+
+  Without AUX the wake latency can't be measured, each wake takes PIN_RECOVER ms
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_SLEEP_MAX_WINDOW	1000		// ms a window stays open for unfinished work
+
+class EBYTESleep {
+
+public:
+
+	EBYTESleep(EBYTE *radio);
+
+	// method to start: a window every period ms, each open at least window ms. The first one is now
+	void		Begin(unsigned long period, unsigned long window, MODE_TYPE awakeMode = MODE_NORMAL);
+
+	// method to stop and leave the module awake
+	void		End();
+
+	// method to run the schedule, call as often as possible. Returns true while the module is awake
+	bool		Poll();
+
+	bool		Awake();
+
+	// work waiting for a window: Post() when it is queued, Done() when it has been sent
+	void		Post();
+	void		Done();
+	uint8_t		Pending();
+
+	// pieces of work waiting that open a window early, 0 waits for the next period
+	void		SetBatch(uint8_t n);
+
+	// ms until the module next has to be woken, 0 while awake. How long the MCU can sleep
+	unsigned long	SleepMillis();
+
+	// us the module is woken ahead of a window
+	uint32_t	WakeLatency();
+
+	// share of the time awake, averaged over the cycles so far
+	float		AwakePercent();
+
+	unsigned long	MaxWindow		= EBYTE_SLEEP_MAX_WINDOW;
+
+	uint32_t	Cycles			= 0;		// windows opened
+	uint32_t	Early			= 0;		// of them opened early by SetBatch
+	uint32_t	Late			= 0;		// windows that started before the module was ready
+	uint32_t	Failures		= 0;		// wakes where AUX never came back up
+	uint32_t	LastLatency		= 0;		// us, last wake
+	uint32_t	MaxLatency		= 0;		// us, longest wake
+	unsigned long	LastAwake	= 0;		// ms awake in the last cycle, wake up included
+	float		AvgAwake		= 0;		// ms awake per cycle
+
+private:
+
+	void		Wake(bool early);
+	void		Sleep();
+
+	EBYTE			*_radio;
+	MODE_TYPE		_awakeMode		= MODE_NORMAL;
+	bool			_running		= false;
+	bool			_awake			= false;
+	uint8_t			_pending		= 0;
+	uint8_t			_batch			= 0;
+	unsigned long	_period			= 0;
+	unsigned long	_window			= 0;
+	unsigned long	_next			= 0;		// millis() the next window starts
+	unsigned long	_opened			= 0;		// millis() this window started
+	unsigned long	_woken			= 0;		// millis() the module was woken
+	unsigned long	_started		= 0;		// millis() Begin() was called
+	unsigned long	_awakeTotal		= 0;		// ms
+	uint32_t		_lead			= 0;		// us woken ahead of a window
+
+};
@@ -0,0 +1,319 @@
+/*
+  Gateway scheduled time slots, see EBYTE_TDMA.h
+*/
+
+#include "EBYTE_TDMA.h"
+
+/*
+read the RSSI byte that follows a packet if it is on. GetStruct would do it too but then waits 20ms,
+which is most of a guard time
+*/
+static void GetRSSI(EBYTE *radio) {
+
+	radio->newRSSIdataAvailable = false;
+
+	if (radio->GetEnableRSSIByte()) {
+		radio->newRSSIdataAvailable = (radio->GetBytes(&radio->RSSIdata, 1) == 1);
+	}
+}
+
+/*
+create the gateway, the slot table is owned by the EBYTETdmaGateway template
+*/
+EBYTETdmaGatewayBase::EBYTETdmaGatewayBase(EBYTE *radio, EBYTETdmaSlot *slots, uint8_t maxSlots) {
+	_radio		= radio;
+	_slots		= slots;
+	_maxSlots	= maxSlots;
+}
+
+void EBYTETdmaGatewayBase::Begin(ebyteReceiveFunc receive) {
+	_receive	= receive;
+	_running	= false;
+	Cycles		= 0;
+	Unknown		= 0;
+}
+
+/*
+method to work out a slot: the bytes over the UART and on air, rounded up to the next ms, plus the guard
+*/
+uint16_t EBYTETdmaGatewayBase::SlotMillis(uint16_t len) {
+	return ((_radio->UARTTimeMicros(len) + _radio->AirTimeMicros(len) + 999) / 1000) + _guard;
+}
+
+bool EBYTETdmaGatewayBase::AddNode(uint16_t address, uint8_t payload) {
+
+	uint8_t i = 0;
+
+	if ((EBYTE_TDMA_HEADER + payload) > _radio->GetSubPacketBytes()) {
+		return false;
+	}
+	while ((i < _count) && (_slots[i].address != address)) {
+		i++;
+	}
+	if (i == _count) {
+		if ((_count >= _maxSlots) || ((3 + (_count + 1) * EBYTE_TDMA_ENTRY) > _radio->GetSubPacketBytes())) {
+			return false;
+		}
+		memset(&_slots[i], 0, sizeof(EBYTETdmaSlot));
+		_count++;
+	}
+	_slots[i].address	= address;
+	_slots[i].payload	= payload;
+	_slots[i].length	= SlotMillis(EBYTE_TDMA_HEADER + payload);
+	return true;
+}
+
+bool EBYTETdmaGatewayBase::RemoveNode(uint16_t address) {
+
+	for (uint8_t i = 0; i < _count; i++) {
+		if (_slots[i].address == address) {
+			// keep the order, the nodes after it move up a slot
+			memmove(&_slots[i], &_slots[i + 1], (_count - i - 1) * sizeof(EBYTETdmaSlot));
+			_count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void EBYTETdmaGatewayBase::SetGuard(uint8_t ms) {
+	_guard = ms;
+}
+
+uint8_t EBYTETdmaGatewayBase::Nodes() {
+	return _count;
+}
+
+const EBYTETdmaSlot *EBYTETdmaGatewayBase::Slot(uint8_t i) {
+	return (i < _count) ? &_slots[i] : nullptr;
+}
+
+float EBYTETdmaGatewayBase::Utilisation(uint8_t i) {
+
+	if ((i >= _count) || (_slots[i].Cycles == 0)) {
+		return 0.0;
+	}
+	return (100.0 * _slots[i].AirUsed) / ((float)_slots[i].length * 1000.0 * _slots[i].Cycles);
+}
+
+uint32_t EBYTETdmaGatewayBase::CycleMillis() {
+
+	uint32_t ms = SlotMillis(3 + _count * EBYTE_TDMA_ENTRY);
+
+	for (uint8_t i = 0; i < _count; i++) {
+		ms += _slots[i].length;
+	}
+	return ms;
+}
+
+/*
+method to close the cycle and write the beacon for the next one
+*/
+void EBYTETdmaGatewayBase::SendBeacon() {
+
+	uint8_t beacon[3 + (200 / EBYTE_TDMA_ENTRY) * EBYTE_TDMA_ENTRY];
+	uint8_t len = 3;
+
+	beacon[0] = EBYTE_TDMA_BEACON;
+	beacon[1] = (uint8_t)Cycles;
+	beacon[2] = _count;
+
+	for (uint8_t i = 0; i < _count; i++) {
+		// worked out again every cycle, the air data rate, UART rate or guard may have changed since AddNode
+		_slots[i].length = SlotMillis(EBYTE_TDMA_HEADER + _slots[i].payload);
+
+		beacon[len++] = (uint8_t)(_slots[i].address >> 8);
+		beacon[len++] = (uint8_t)_slots[i].address;
+		beacon[len++] = (uint8_t)_slots[i].length;
+		beacon[len++] = (uint8_t)(_slots[i].length >> 8);
+	}
+
+	// refused by the duty cycle budget: the cycle stays open, the beacon is tried again on the next Poll().
+	// One written in part is in the module, it goes out as it is
+	if (_radio->SendBytes(beacon, len) == 0) {
+		BeaconsRefused++;
+		return;
+	}
+
+	for (uint8_t i = 0; i < _count; i++) {
+		if (_running && !_slots[i].used) {
+			_slots[i].Unused++;
+		}
+		_slots[i].used = false;
+		_slots[i].Cycles++;
+	}
+
+	_beaconLength	= SlotMillis(len);
+	_cycleStart		= millis();
+	_running		= true;
+	Cycles++;
+}
+
+/*
+method to read one node frame if one is waiting
+*/
+void EBYTETdmaGatewayBase::Receive() {
+
+	uint8_t header[EBYTE_TDMA_HEADER];
+	uint8_t data[200];
+
+	if (!_radio->available()) {
+		return;
+	}
+	if (_radio->GetBytes(header, EBYTE_TDMA_HEADER) != EBYTE_TDMA_HEADER) {
+		return;
+	}
+	if ((header[0] != EBYTE_TDMA_FRAME) || (header[3] > (sizeof(data) - EBYTE_TDMA_HEADER))) {
+		_radio->DropPacket();
+		return;
+	}
+	if (_radio->GetBytes(data, header[3]) != header[3]) {
+		return;
+	}
+	GetRSSI(_radio);
+
+	uint16_t		address = (header[1] << 8) | header[2];
+	unsigned long	end		= _beaconLength;
+
+	for (uint8_t i = 0; i < _count; i++) {
+
+		end += _slots[i].length;
+
+		if (_slots[i].address == address) {
+			// read after the end of the slot, it ran into the next one
+			if ((millis() - _cycleStart) > (end + _guard)) {
+				_slots[i].Late++;
+			}
+			_slots[i].used = true;
+			_slots[i].Frames++;
+			_slots[i].Bytes		+= header[3];
+			_slots[i].AirUsed	+= _radio->AirTimeMicros(EBYTE_TDMA_HEADER + header[3]);
+
+			if (_receive) {
+				_receive(address, data, header[3]);
+			}
+			return;
+		}
+	}
+	Unknown++;
+}
+
+void EBYTETdmaGatewayBase::Poll() {
+
+	Receive();
+
+	if ((!_running || ((millis() - _cycleStart) >= CycleMillis())) && (_count > 0) && _radio->GetAux()) {
+		SendBeacon();
+	}
+}
+
+/*
+create the node, the frame buffer is owned by the EBYTETdmaNode template
+*/
+EBYTETdmaNodeBase::EBYTETdmaNodeBase(EBYTE *radio, uint8_t *frame, uint8_t maxPayload) {
+	_radio		= radio;
+	_frame		= frame;
+	_maxPayload	= maxPayload;
+}
+
+bool EBYTETdmaNodeBase::Send(const void *data, uint8_t len) {
+
+	uint16_t address = _radio->GetAddress();
+
+	if ((len > _maxPayload) || (_len != 0)) {
+		return false;
+	}
+	_frame[0] = EBYTE_TDMA_FRAME;
+	_frame[1] = (uint8_t)(address >> 8);
+	_frame[2] = (uint8_t)address;
+	_frame[3] = len;
+	memcpy(&_frame[EBYTE_TDMA_HEADER], data, len);
+	_len = EBYTE_TDMA_HEADER + len;
+	return true;
+}
+
+bool EBYTETdmaNodeBase::Synced() {
+	return (_slotLength != 0) && ((millis() - _beacon) < (2 * _cycle));
+}
+
+bool EBYTETdmaNodeBase::Pending() {
+	return _len != 0;
+}
+
+/*
+method to read one packet, beacons set our slot for the cycle, other nodes' frames are dropped
+*/
+void EBYTETdmaNodeBase::Receive() {
+
+	uint8_t			header[3];
+	uint8_t			entry[EBYTE_TDMA_ENTRY];
+	uint16_t		address = _radio->GetAddress();
+	unsigned long	offset	= 0;
+
+	if (!_radio->available()) {
+		return;
+	}
+	if ((_radio->GetBytes(header, 3) != 3) || (header[0] != EBYTE_TDMA_BEACON)) {
+		_radio->DropPacket();
+		return;
+	}
+
+	_beacon		= millis();
+	_slotLength = 0;
+	_slotted	= false;
+
+	for (uint8_t i = 0; i < header[2]; i++) {
+
+		if (_radio->GetBytes(entry, EBYTE_TDMA_ENTRY) != EBYTE_TDMA_ENTRY) {
+			_slotLength = 0;
+			return;
+		}
+
+		uint16_t length = entry[2] | (entry[3] << 8);
+
+		if (((entry[0] << 8) | entry[1]) == address) {
+			_slotStart	= offset;
+			_slotLength = length;
+			_slotted	= true;
+		}
+		offset += length;
+	}
+	_cycle = offset;
+
+	GetRSSI(_radio);
+
+	Beacons++;
+}
+
+void EBYTETdmaNodeBase::Poll() {
+
+	Receive();
+
+	if (!_slotted || (_len == 0)) {
+		return;
+	}
+
+	unsigned long in		= millis() - _beacon;
+	unsigned long frame		= (_radio->UARTTimeMicros(_len) + _radio->AirTimeMicros(_len) + 999) / 1000;
+
+	if (in < _slotStart) {
+		return;
+	}
+
+	// one chance per cycle, if it does not fit what is left of the slot wait for the next beacon
+	_slotted = false;
+
+	if ((in + frame) > (_slotStart + _slotLength)) {
+		TooLong++;
+		return;
+	}
+	// refused by the duty cycle budget: the frame stays queued for the next slot. One written in part is
+	// in the module, written again it would go out twice
+	if (_radio->SendBytes(_frame, _len) == 0) {
+		Refused++;
+		return;
+	}
+	_len = 0;
+	Sent++;
+}
+
@@ -0,0 +1,179 @@
+#pragma once
+/*
+  Gateway scheduled time slots (TDMA) for many nodes sharing one channel
+
+  Nodes sending on their own timers collide more and more as the channel fills, LBT only helps a
+  little. Here the gateway owns the channel: it starts every cycle with a beacon listing the nodes in
+  order with the length of their slot, and each node writes only inside its own slot. A slot is the
+  time the node's frame takes over the UART and on air (from the payload size and the air data rate,
+  see AirTimeMicros) plus a guard time, so the cycle is as short as the traffic allows.
+
+  Beacon	[0xC5][cycle][node count] then per node [addr hi][addr lo][slot ms lo][slot ms hi]
+  Frame		[0xC6][addr hi][addr lo][payload length][payload]
+
+  Slots follow each other straight after the beacon. Each node times its slot from the moment it read
+  the beacon and sends at most one frame per cycle. A node that missed the beacon stays silent for the
+  cycle. The gateway counts, per slot, the frames and bytes received, the cycles the slot went unused
+  and the frames that arrived outside their slot, and works out how much of the slot's airtime was used.
+
+  All modules must be in transparent mode on the same address and channel, the node's address for the
+  schedule is its own module address (SetAddress), which must be unique. Beacon and frames must each
+  fit one sub packet: 3 + 4 bytes per node for the beacon.
+
+  Usage
+	EBYTETdmaGateway<16> Gateway(&Transceiver);
+	setup():	Gateway.Begin(OnFrame);
+				Gateway.AddNode(0x0010, sizeof(DATA));
+	loop():		Gateway.Poll();
+
+	EBYTETdmaNode<sizeof(DATA)> Node(&Transceiver);
+	loop():		Node.Poll();
+				if (NewReading) Node.Send(&MyData, sizeof(MyData));		// goes out in the next slot
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_TDMA_BEACON		0xC5
+#define EBYTE_TDMA_FRAME		0xC6
+
+#define EBYTE_TDMA_HEADER		4		// frame header
+#define EBYTE_TDMA_ENTRY		4		// beacon bytes per node
+#define EBYTE_TDMA_GUARD		10		// ms added to each slot and to the beacon for timing errors
+
+struct EBYTETdmaSlot {
+	uint16_t	address;
+	uint16_t	length;				// ms
+	uint8_t		payload;			// largest payload the node sends
+	bool		used;				// frame received this cycle
+	uint16_t	Frames;				// frames received
+	uint16_t	Unused;				// cycles without a frame
+	uint16_t	Late;				// frames received outside the slot
+	uint16_t	Cycles;				// cycles the slot was scheduled in
+	uint32_t	Bytes;				// payload bytes received
+	uint32_t	AirUsed;			// us of airtime used by received frames
+};
+
+class EBYTETdmaGatewayBase {
+
+public:
+
+	// method to start scheduling, receive is called with each node frame
+	void		Begin(ebyteReceiveFunc receive);
+
+	// methods to manage the schedule, the new schedule goes out with the next beacon. AddNode is false if
+	// the table is full or the beacon or frame would not fit a sub packet
+	bool		AddNode(uint16_t address, uint8_t payload);
+	bool		RemoveNode(uint16_t address);
+
+	// ms added to each slot, default EBYTE_TDMA_GUARD. Slot lengths are worked out again for each beacon,
+	// so this and changes of air data rate or UART rate apply from the next cycle
+	void		SetGuard(uint8_t ms);
+
+	// method to run the schedule, call as often as possible
+	void		Poll();
+
+	uint8_t					Nodes();
+	const EBYTETdmaSlot		*Slot(uint8_t i);
+
+	// percent of the slot's airtime used by received frames
+	float		Utilisation(uint8_t i);
+
+	// length of a full cycle, beacon included
+	uint32_t	CycleMillis();
+
+	uint16_t	Cycles		= 0;		// beacons sent
+	uint16_t	Unknown		= 0;		// frames from nodes not in the schedule
+	uint16_t	BeaconsRefused	= 0;	// beacons refused by the duty cycle budget, tried again
+
+protected:
+
+	EBYTETdmaGatewayBase(EBYTE *radio, EBYTETdmaSlot *slots, uint8_t maxSlots);
+
+private:
+
+	uint16_t	SlotMillis(uint16_t len);
+	void		SendBeacon();
+	void		Receive();
+
+	EBYTE				*_radio;
+	EBYTETdmaSlot		*_slots;
+	uint8_t				_maxSlots;
+	uint8_t				_count			= 0;
+	uint8_t				_guard			= EBYTE_TDMA_GUARD;
+	uint16_t			_beaconLength	= 0;		// ms from the beacon write to the first slot
+	bool				_running		= false;
+	unsigned long		_cycleStart		= 0;		// millis() the beacon was written
+	ebyteReceiveFunc	_receive		= nullptr;
+
+};
+
+template <uint8_t MaxNodes>
+class EBYTETdmaGateway : public EBYTETdmaGatewayBase {
+
+	static_assert(3 + (MaxNodes * EBYTE_TDMA_ENTRY) <= 200, "EBYTETdmaGateway: beacon must fit a 200 byte sub packet");
+
+public:
+
+	EBYTETdmaGateway(EBYTE *radio) : EBYTETdmaGatewayBase(radio, _slotTable, MaxNodes) {}
+
+private:
+
+	EBYTETdmaSlot _slotTable[MaxNodes];
+
+};
+
+class EBYTETdmaNodeBase {
+
+public:
+
+	// method to queue a frame for the next slot, false if it is too long or one is already queued
+	bool		Send(const void *data, uint8_t len);
+
+	// method to read beacons and write the queued frame in our slot, call as often as possible
+	void		Poll();
+
+	// true if the last beacon had a slot for us and was heard within the last two cycles
+	bool		Synced();
+
+	// true while a frame is waiting for the slot
+	bool		Pending();
+
+	uint16_t	Beacons		= 0;		// beacons received
+	uint16_t	Sent		= 0;		// frames written
+	uint16_t	TooLong		= 0;		// frames held back as they did not fit the slot
+	uint16_t	Refused		= 0;		// frames refused by the duty cycle budget, kept for the next slot
+
+protected:
+
+	EBYTETdmaNodeBase(EBYTE *radio, uint8_t *frame, uint8_t maxPayload);
+
+private:
+
+	void		Receive();
+
+	EBYTE			*_radio;
+	uint8_t			*_frame;
+	uint8_t			_maxPayload;
+	uint8_t			_len			= 0;			// queued frame, 0 if none
+	bool			_slotted		= false;		// our slot in this cycle is still to come
+	unsigned long	_beacon			= 0;			// millis() the last beacon was read
+	unsigned long	_cycle			= 0;			// ms
+	unsigned long	_slotStart		= 0;			// ms after the beacon
+	unsigned long	_slotLength		= 0;			// ms
+
+};
+
+template <uint8_t MaxPayload>
+class EBYTETdmaNode : public EBYTETdmaNodeBase {
+
+	static_assert(MaxPayload + EBYTE_TDMA_HEADER <= 200, "EBYTETdmaNode: frame must fit a 200 byte sub packet");
+
+public:
+
+	EBYTETdmaNode(EBYTE *radio) : EBYTETdmaNodeBase(radio, _frameData, MaxPayload) {}
+
+private:
+
+	uint8_t _frameData[EBYTE_TDMA_HEADER + MaxPayload];
+
+};
@@ -0,0 +1,260 @@
+/*
+  Over the air time synchronisation, see EBYTE_TimeSync.h
+*/
+
+#include "EBYTE_TimeSync.h"
+#include "EBYTE_DutyCycle.h"
+
+// AUX edge times, written by the interrupt
+static int8_t				syncAuxPin	= -1;
+static volatile uint32_t	auxFall		= 0;
+static volatile uint32_t	auxRise		= 0;
+static volatile bool		auxFell		= false;
+static volatile bool		auxRose		= false;
+
+static void AuxEdge() {
+
+	uint32_t t = micros();
+
+	if (digitalReadFast(syncAuxPin)) {
+		auxRise = t;
+		auxRose = true;
+	}
+	else {
+		auxFall = t;
+		auxFell = true;
+	}
+}
+
+EBYTETimeSync::EBYTETimeSync(EBYTE *radio) {
+	_radio = radio;
+}
+
+void EBYTETimeSync::Begin(bool master) {
+
+	_master = master;
+	_waitTx = false;
+	_waitUp = false;
+	_count	= 0;
+	_last	= millis() - _interval;		// master sends the first SYNC straight away
+	Syncs	= 0;
+	Missed	= 0;
+
+	syncAuxPin	= _radio->GetAuxPin();
+	_edges		= (syncAuxPin != -1);
+
+	if (_edges) {
+		attachInterrupt(digitalPinToInterrupt(syncAuxPin), AuxEdge, CHANGE);
+	}
+}
+
+void EBYTETimeSync::End() {
+
+	if (_edges) {
+		detachInterrupt(digitalPinToInterrupt(syncAuxPin));
+		_edges = false;
+	}
+}
+
+void EBYTETimeSync::SetInterval(unsigned long ms) {
+	_interval = ms;
+}
+
+void EBYTETimeSync::SetLatency(uint32_t us) {
+	_latency = us;
+}
+
+bool EBYTETimeSync::Synced() {
+	return _master || ((_count >= 2) && ((uint32_t)(micros() - _refLocal) < (4 * _period)));
+}
+
+uint32_t EBYTETimeSync::Micros() {
+	return ToNetwork(micros());
+}
+
+uint32_t EBYTETimeSync::ToNetwork(uint32_t local) {
+
+	if (_master) {
+		return local;
+	}
+
+	int32_t d = (int32_t)(local - _refLocal);
+
+	// only the small drift correction goes through float, d itself would lose precision
+	return _refNetwork + d + (int32_t)(d * _drift);
+}
+
+uint32_t EBYTETimeSync::ToLocal(uint32_t network) {
+
+	if (_master) {
+		return network;
+	}
+
+	int32_t d = (int32_t)(network - _refNetwork);
+
+	return _refLocal + d - (int32_t)(d * _drift / (1.0 + _drift));
+}
+
+uint32_t EBYTETimeSync::ErrorMicros() {
+	return _jitter + (uint32_t)(_driftStep * (uint32_t)(micros() - _refLocal));
+}
+
+float EBYTETimeSync::DriftPPM() {
+	return _drift * 1000000.0;
+}
+
+/*
+method to fit the clock to a new (local, network) pair. The first two set offset and drift, after that
+half of the prediction error goes into the offset and a quarter, spread over the interval, into the drift
+*/
+void EBYTETimeSync::Update(uint32_t local, uint32_t network) {
+
+	int32_t dt = (int32_t)(local - _refLocal);
+
+	if ((_count == 0) || (dt <= 0)) {
+		_refLocal	= local;
+		_refNetwork = network;
+		_count		= 1;
+		return;
+	}
+
+	uint32_t	predicted	= ToNetwork(local);
+	int32_t		err			= (int32_t)(network - predicted);
+
+	if (_count == 1) {
+		_drift		= (float)((int32_t)(network - _refNetwork) - dt) / dt;
+		_driftStep	= fabs(_drift);
+		_jitter		= 0;
+		_refNetwork = network;
+		_count		= 2;
+	}
+	else {
+		float step	= ((float)err / 4.0) / dt;
+
+		_drift		+= step;
+		_driftStep	= fabs(step);
+		_jitter		+= ((int32_t)abs(err) - (int32_t)_jitter) / 4;
+		_refNetwork = predicted + (err / 2);
+	}
+	_refLocal	= local;
+	_period		= dt;
+}
+
+void EBYTETimeSync::MasterPoll() {
+
+	uint8_t frame[6];
+
+	if (_waitTx) {
+
+		uint32_t sent = _radio->UARTTimeMicros(2) + _radio->AirTimeMicros(2);
+
+		// the SYNC is out when AUX is back up after falling, without AUX allow for the computed time
+		if (_edges ? !(auxFell && _radio->GetAux()) : ((uint32_t)(micros() - _written) < sent)) {
+			if ((uint32_t)(micros() - _written) > (sent + 100000UL)) {
+				_waitTx = false;		// module never took it, try again next interval
+			}
+			return;
+		}
+
+		// TX start plus the time over the UART and on air, when the SYNC finished on air
+		uint32_t t = (_edges ? auxFall : _written) + sent;
+
+		frame[0] = EBYTE_SYNC_FOLLOW_UP;
+		frame[1] = _seq;
+		frame[2] = (uint8_t)t;
+		frame[3] = (uint8_t)(t >> 8);
+		frame[4] = (uint8_t)(t >> 16);
+		frame[5] = (uint8_t)(t >> 24);
+		_waitTx = false;
+		if (_radio->SendBytes(frame, 6) == 6) {
+			Syncs++;
+		}
+		return;
+	}
+
+	if (((millis() - _last) >= _interval) && (!_edges || _radio->GetAux())) {
+
+		EBYTEDutyCycle *budget = _radio->GetDutyCycle();
+
+		_last = millis();
+
+		// a SYNC is no use without its FOLLOW_UP, both must fit the duty cycle budget or neither goes
+		if (budget && !budget->CanSend(_radio->AirTimeMicros(2) + _radio->AirTimeMicros(6))) {
+			return;
+		}
+		frame[0]	= EBYTE_SYNC;
+		frame[1]	= ++_seq;
+		auxFell		= false;
+		_written	= micros();
+		_waitTx		= (_radio->SendBytes(frame, 2) == 2);
+	}
+}
+
+void EBYTETimeSync::SlavePoll() {
+
+	uint8_t header[2];
+	uint8_t time[4];
+	uint8_t rssi = _radio->GetEnableRSSIByte() ? 1 : 0;
+
+	if (!_radio->available()) {
+		return;
+	}
+	if (_radio->GetBytes(header, 2) != 2) {
+		return;
+	}
+
+	if (header[0] == EBYTE_SYNC) {
+
+		if (rssi) {
+			_radio->GetBytes(&_radio->RSSIdata, 1);
+		}
+		_rxDone = micros();
+
+		if (_edges) {
+			// RX completion is AUX going back up, which can be just after the last byte is read
+			elapsedMillis t = 0;
+			while (!_radio->GetAux() && (t < 10)) {}
+			if (auxRose) {
+				_rxDone = auxRise;
+			}
+			auxRose = false;
+		}
+		_seq	= header[1];
+		_waitUp = true;
+		return;
+	}
+
+	if (header[0] == EBYTE_SYNC_FOLLOW_UP) {
+
+		if (_radio->GetBytes(time, 4) != 4) {
+			return;
+		}
+		if (rssi) {
+			_radio->GetBytes(&_radio->RSSIdata, 1);
+		}
+		if (!_waitUp || (header[1] != _seq)) {
+			Missed++;
+			return;
+		}
+		_waitUp = false;
+
+		uint32_t t = time[0] | ((uint32_t)time[1] << 8) | ((uint32_t)time[2] << 16) | ((uint32_t)time[3] << 24);
+
+		// the SYNC was on air at t, then the module's latency, then our UART to the end of the SYNC
+		Update(_rxDone, t + _latency + _radio->UARTTimeMicros(2 + rssi));
+		Syncs++;
+		return;
+	}
+
+	_radio->DropPacket();
+}
+
+void EBYTETimeSync::Poll() {
+
+	if (_master) {
+		MasterPoll();
+	}
+	else {
+		SlavePoll();
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+/*
+  Over the air time synchronisation
+
+  One node is the master, its micros() is the network time. Every interval it sends a SYNC and, once
+  that has gone out, a FOLLOW_UP with the time the SYNC went out (two step, so the time is not needed
+  before the SYNC is written). Slaves time the SYNC as it arrives and fit their clock to the master's.
+
+	SYNC		[0xD0][seq]
+	FOLLOW_UP	[0xD1][seq][time us, 4 bytes little endian]
+
+  Timestamps come from AUX edges, caught with attachInterrupt so loop() latency does not matter:
+	master	AUX falls when the module takes the SYNC from the UART (TX start). The time sent is that plus
+			the UART time and airtime of the SYNC, the moment it finishes on air
+	slave	AUX rises when the module has passed the SYNC out of its UART (RX completion). That moment
+			in network time is the time sent plus the slave's UART time for the SYNC (and RSSI byte)
+  Both use the configured rates (UARTTimeMicros, AirTimeMicros). Without an AUX pin the write and read
+  times are used, which is a few ms worse.
+
+  What is left is the module's own processing, which is the same for every slave. SetLatency() adds it
+  if times must match the master's exactly; for slots and wake ups only the slaves agreeing matters.
+
+  The slave keeps an offset and a drift (crystal error, typically tens of ppm) and corrects both at each
+  SYNC, so its clock stays on between SYNCs. ErrorMicros() estimates how far off it is: the recent
+  SYNC to prediction differences plus the drift uncertainty times the time since the last SYNC.
+
+  Usage
+	EBYTETimeSync Sync(&Transceiver);
+	master	setup(): Sync.Begin(true);		loop(): Sync.Poll();
+	slave	setup(): Sync.Begin(false);		loop(): Sync.Poll(); if (Sync.Synced()) Stamp = Sync.Micros();
+
+  While the master sends, the link should be quiet. Only one EBYTETimeSync per sketch (one interrupt).
+  Network time wraps like micros(), every 71 minutes, so compare times by subtracting them
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_SYNC				0xD0
+#define EBYTE_SYNC_FOLLOW_UP	0xD1
+
+#define EBYTE_SYNC_INTERVAL		10000		// ms between SYNCs from the master
+
+class EBYTETimeSync {
+
+public:
+
+	EBYTETimeSync(EBYTE *radio);
+
+	// method to start as master or slave, attaches the AUX interrupt if there is an AUX pin
+	void		Begin(bool master);
+	void		End();
+
+	// method to send (master) or read (slave) SYNCs, call as often as possible
+	void		Poll();
+
+	// master: ms between SYNCs
+	void		SetInterval(unsigned long ms);
+
+	// slave: us of module processing between the end of a packet on air and the UART output
+	void		SetLatency(uint32_t us);
+
+	// slave: true after two SYNCs, until four intervals pass without one
+	bool		Synced();
+
+	// network time now, and conversions from and to this node's micros()
+	uint32_t	Micros();
+	uint32_t	ToNetwork(uint32_t local);
+	uint32_t	ToLocal(uint32_t network);
+
+	// slave: estimated error of Micros() in us, clock drift against the master in ppm
+	uint32_t	ErrorMicros();
+	float		DriftPPM();
+
+	uint16_t	Syncs		= 0;		// master: SYNCs sent. slave: SYNCs used
+	uint16_t	Missed		= 0;		// slave: FOLLOW_UPs that did not match the SYNC
+
+private:
+
+	void		MasterPoll();
+	void		SlavePoll();
+	void		Update(uint32_t local, uint32_t network);
+
+	EBYTE			*_radio;
+	bool			_master		= false;
+	bool			_edges		= false;		// AUX interrupt attached
+	uint8_t			_seq		= 0;
+	bool			_waitTx		= false;		// master: SYNC written, FOLLOW_UP to send
+	bool			_waitUp		= false;		// slave: SYNC read, FOLLOW_UP to come
+	uint32_t		_written	= 0;			// master: micros() the SYNC was written
+	uint32_t		_rxDone		= 0;			// slave: micros() the SYNC was read
+	unsigned long	_interval	= EBYTE_SYNC_INTERVAL;
+	unsigned long	_last		= 0;			// master: millis() of the last SYNC
+	uint32_t		_latency	= 0;
+
+	uint8_t			_count		= 0;			// SYNCs in the fit, up to 2
+	uint32_t		_refLocal	= 0;			// last fit point, local and network us
+	uint32_t		_refNetwork	= 0;
+	uint32_t		_period		= 0;			// us between the last two SYNCs
+	float			_drift		= 0.0;			// network us per local us, less 1
+	float			_driftStep	= 0.0;			// size of the last drift correction
+	uint32_t		_jitter		= 0;			// us, smoothed prediction error
+
+};
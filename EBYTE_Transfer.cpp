@@ -0,0 +1,436 @@
+/*
+  Bulk transfer, see EBYTE_Transfer.h
+*/
+
+#include "EBYTE_Transfer.h"
+
+static bool GetBit(const uint8_t *map, uint16_t n) {
+	return map[n >> 3] & (1 << (n & 7));
+}
+
+static void SetBit(uint8_t *map, uint16_t n, bool val) {
+	if (val) {
+		map[n >> 3] |= (uint8_t)(1 << (n & 7));
+	}
+	else {
+		map[n >> 3] &= (uint8_t)~(1 << (n & 7));
+	}
+}
+
+/*
+create the sender, the bitmap is owned by the EBYTEBulkSender template
+*/
+EBYTEBulkSenderBase::EBYTEBulkSenderBase(EBYTE *radio, uint8_t *pending, uint16_t maxBlocks) {
+	_radio		= radio;
+	_pending	= pending;
+	_maxBlocks	= maxBlocks;
+}
+
+bool EBYTEBulkSenderBase::Begin(uint8_t id, uint32_t size, ebyteReadFunc read) {
+
+	uint8_t		blockSize	= _radio->GetSubPacketBytes() - EBYTE_XFER_HEADER;
+	uint32_t	blocks		= (size + blockSize - 1) / blockSize;
+
+	if ((blocks > _maxBlocks) || (read == nullptr)) {
+		return false;
+	}
+
+	_id				= id;
+	_size			= size;
+	_read			= read;
+	_blockSize		= blockSize;
+	_blocks			= blocks;
+	_next			= 0;
+	_retries		= 0;
+	_inFlight		= 0;
+	_drained		= micros();
+	_started		= millis();
+	_finished		= 0;
+	BytesSent		= 0;
+	BlocksResent	= 0;
+
+	memset(_pending, 0, (_maxBlocks + 7) / 8);
+	for (uint16_t b = 0; b < _blocks; b++) {
+		SetBit(_pending, b, true);
+	}
+
+	_state = XFER_START;
+	return true;
+}
+
+XFER_STATE EBYTEBulkSenderBase::State() {
+	return _state;
+}
+
+uint16_t EBYTEBulkSenderBase::Blocks() {
+	return _blocks;
+}
+
+uint32_t EBYTEBulkSenderBase::Throughput() {
+
+	unsigned long elapsed = (_finished ? _finished : millis()) - _started;
+
+	if (elapsed == 0) {
+		return 0;
+	}
+	return (uint32_t)(((uint64_t)((_state == XFER_DONE) ? _size : BytesSent) * 1000) / elapsed);
+}
+
+uint32_t EBYTEBulkSenderBase::MaxThroughput() {
+	return _radio->GetAirDataRateBps() / 8;
+}
+
+/*
+method to check there is room in the module's buffer for len more bytes. The bytes in the module
+are estimated from what was written and the time a full sub packet takes on air. AUX high after the
+last write has had time to cross the UART means the module has sent everything
+*/
+bool EBYTEBulkSenderBase::Ready(uint16_t len) {
+
+	unsigned long	now		= micros();
+	uint8_t			packet	= _radio->GetSubPacketBytes();
+	uint32_t		sent	= (uint32_t)(((uint64_t)(now - _drained) * packet) / _radio->AirTimeMicros(packet));
+
+	if (sent) {
+		_inFlight	= (sent >= _inFlight) ? 0 : (_inFlight - sent);
+		_drained	= now;
+	}
+
+	if (_inFlight && _radio->GetAux() && ((now - _written) > (_radio->UARTTimeMicros(packet) + 2000))) {
+		_inFlight	= 0;
+		_drained	= now;
+	}
+
+	return (_inFlight + len) <= EBYTE_MODULE_BUFFER;
+}
+
+/*
+method to check the last write has gone out on air. A frame written while the one before it is still
+crossing the UART goes out in the same sub packet, and a receiver reading the first with GetStruct
+would take the second's first byte for the RSSI byte
+*/
+bool EBYTEBulkSenderBase::Sent() {
+
+	uint32_t since = micros() - _written;
+
+	if (_radio->GetAuxPin() != -1) {
+		return _radio->GetAux() && (since > (_radio->UARTTimeMicros(_lastLen) + 2000));
+	}
+	// the module waits three bytes' time after the last one before it sends
+	return since >= (_radio->UARTTimeMicros(_lastLen + 3) + _radio->AirTimeMicros(_lastLen));
+}
+
+/*
+method to write one frame, false if the module (or the duty cycle budget) didn't take all of it
+*/
+bool EBYTEBulkSenderBase::Write(uint8_t type, uint16_t p, const uint8_t *payload, uint8_t len) {
+
+	uint8_t header[EBYTE_XFER_HEADER] = { type, _id, (uint8_t)p, (uint8_t)(p >> 8), len };
+
+	if (_radio->SendFrame(header, sizeof(header), payload, len) != (sizeof(header) + len)) {
+		return false;
+	}
+	_inFlight	+= sizeof(header) + len;
+	_written	= micros();
+	_lastLen	= sizeof(header) + len;
+	return true;
+}
+
+/*
+method to give the receiver time to answer: everything still queued has to go out, then the
+receiver's bitmap has to come back
+*/
+void EBYTEBulkSenderBase::WaitForStatus() {
+	_waitStart	= millis();
+	_waitFor	= ((_radio->AirTimeMicros(_inFlight) + 2 * _radio->AirTimeMicros(_radio->GetSubPacketBytes())) / 1000) + 100;
+}
+
+/*
+method to read the receiver's bitmap if one has arrived and mark the blocks it is missing
+*/
+bool EBYTEBulkSenderBase::GetStatus() {
+
+	uint8_t header[EBYTE_XFER_HEADER];
+	uint8_t map[200 - EBYTE_XFER_HEADER];
+
+	if (!_radio->available()) {
+		return false;
+	}
+	if (_radio->GetBytes(header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+	if ((header[0] != EBYTE_XFER_STATUS) || (header[1] != _id) || (header[4] > sizeof(map))) {
+		_radio->DropPacket();
+		return false;
+	}
+	if (!_radio->GetStruct(map, header[4])) {
+		return false;
+	}
+
+	uint16_t base	= header[2] | (header[3] << 8);
+	uint32_t end	= (uint32_t)base + 8 * header[4];
+
+	// blocks before the map have all arrived, blocks after it are sent (again)
+	for (uint16_t b = 0; b < _blocks; b++) {
+
+		bool received = (b < base) || ((b < end) && GetBit(map, b - base));
+
+		if (!received && !GetBit(_pending, b) && (_state == XFER_WAIT)) {
+			BlocksResent++;
+		}
+		SetBit(_pending, b, !received);
+	}
+	return true;
+}
+
+bool EBYTEBulkSenderBase::Poll() {
+
+	switch (_state) {
+
+	case XFER_START:
+		if (Ready(EBYTE_XFER_HEADER + 5)) {
+			uint8_t info[5] = { (uint8_t)_size, (uint8_t)(_size >> 8), (uint8_t)(_size >> 16), (uint8_t)(_size >> 24), _blockSize };
+
+			if (Write(EBYTE_XFER_START, _blocks, info, sizeof(info))) {
+				WaitForStatus();
+				_state = XFER_RESUME;
+			}
+		}
+		break;
+
+	case XFER_RESUME:
+		// a receiver that already has part of this transfer answers START with its bitmap
+		if (GetStatus() || ((millis() - _waitStart) > _waitFor)) {
+			_next	= 0;
+			_state	= XFER_SENDING;
+		}
+		break;
+
+	case XFER_SENDING:
+		while ((_next < _blocks) && !GetBit(_pending, _next)) {
+			_next++;
+		}
+		if (_next >= _blocks) {
+			// END must not join the last block in one sub packet
+			if (Sent() && Ready(EBYTE_XFER_HEADER) && Write(EBYTE_XFER_END, _blocks, nullptr, 0)) {
+				WaitForStatus();
+				_state = XFER_WAIT;
+			}
+		}
+		else {
+			uint32_t	offset	= (uint32_t)_next * _blockSize;
+			uint8_t		len		= ((_size - offset) < _blockSize) ? (uint8_t)(_size - offset) : _blockSize;
+
+			if (Ready(EBYTE_XFER_HEADER + len)) {
+				uint8_t data[200 - EBYTE_XFER_HEADER];
+
+				len = _read(offset, data, len);
+				if (Write(EBYTE_XFER_DATA, _next, data, len)) {
+					SetBit(_pending, _next, false);
+					BytesSent += len;
+					_next++;
+				}
+			}
+		}
+		break;
+
+	case XFER_WAIT:
+		if (GetStatus()) {
+			_retries	= 0;
+			_next		= 0;
+			_state		= XFER_SENDING;
+
+			bool done = true;
+			for (uint16_t b = 0; done && (b < _blocks); b++) {
+				done = !GetBit(_pending, b);
+			}
+			if (done) {
+				_state		= XFER_DONE;
+				_finished	= millis();
+			}
+		}
+		else if ((millis() - _waitStart) > _waitFor) {
+			if (++_retries > EBYTE_XFER_RETRIES) {
+				_state		= XFER_FAILED;
+				_finished	= millis();
+			}
+			else {
+				Write(EBYTE_XFER_END, _blocks, nullptr, 0);
+				WaitForStatus();
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return (_state != XFER_IDLE) && (_state != XFER_DONE) && (_state != XFER_FAILED);
+}
+
+/*
+create the receiver, the bitmap is owned by the EBYTEBulkReceiver template
+*/
+EBYTEBulkReceiverBase::EBYTEBulkReceiverBase(EBYTE *radio, uint8_t *received, uint16_t maxBlocks, ebyteWriteFunc write) {
+	_radio		= radio;
+	_received	= received;
+	_maxBlocks	= maxBlocks;
+	_write		= write;
+	memset(_received, 0, BitmapBytes());
+}
+
+bool EBYTEBulkReceiverBase::Complete() {
+	return _active && (_count == _blocks);
+}
+
+uint8_t EBYTEBulkReceiverBase::Id() {
+	return _id;
+}
+
+uint32_t EBYTEBulkReceiverBase::Size() {
+	return _size;
+}
+
+uint16_t EBYTEBulkReceiverBase::BlocksReceived() {
+	return _count;
+}
+
+uint8_t *EBYTEBulkReceiverBase::Bitmap() {
+	return _received;
+}
+
+uint16_t EBYTEBulkReceiverBase::BitmapBytes() {
+	return (_maxBlocks + 7) / 8;
+}
+
+uint8_t EBYTEBulkReceiverBase::BlockSize() {
+	return _blockSize;
+}
+
+bool EBYTEBulkReceiverBase::Restore(uint8_t id, uint32_t size, uint8_t blockSize) {
+
+	uint32_t blocks = blockSize ? ((size + blockSize - 1) / blockSize) : 0;
+
+	if ((blocks == 0) || (blocks > _maxBlocks)) {
+		return false;
+	}
+
+	_id			= id;
+	_size		= size;
+	_blockSize	= blockSize;
+	_blocks		= blocks;
+	_count		= 0;
+	_active		= true;
+
+	for (uint16_t b = 0; b < _blocks; b++) {
+		_count += GetBit(_received, b);
+	}
+	return true;
+}
+
+/*
+method to send the bitmap from the first missing block on, as much as fits a sub packet
+*/
+void EBYTEBulkReceiverBase::SendStatus() {
+
+	uint8_t		header[EBYTE_XFER_HEADER];
+	uint16_t	first	= 0;
+	uint16_t	bytes;
+
+	while ((first < _blocks) && GetBit(_received, first)) {
+		first++;
+	}
+	first &= ~7;
+
+	bytes = (_blocks - first + 7) / 8;
+	if (bytes > (uint16_t)(_radio->GetSubPacketBytes() - EBYTE_XFER_HEADER)) {
+		bytes = _radio->GetSubPacketBytes() - EBYTE_XFER_HEADER;
+	}
+
+	header[0] = EBYTE_XFER_STATUS;
+	header[1] = _id;
+	header[2] = (uint8_t)first;
+	header[3] = (uint8_t)(first >> 8);
+	header[4] = (uint8_t)bytes;
+
+	// written back to back so they go out as one packet, and charged as one
+	_radio->SendFrame(header, sizeof(header), &_received[first >> 3], bytes);
+}
+
+bool EBYTEBulkReceiverBase::Poll() {
+
+	uint8_t header[EBYTE_XFER_HEADER];
+	uint8_t data[200 - EBYTE_XFER_HEADER];
+
+	if (!_radio->available()) {
+		return false;
+	}
+	if (_radio->GetBytes(header, sizeof(header)) != sizeof(header)) {
+		return false;
+	}
+	if ((header[0] < EBYTE_XFER_START) || (header[0] > EBYTE_XFER_END) || (header[4] > sizeof(data))) {
+		_radio->DropPacket();
+		return false;
+	}
+	if (!_radio->GetStruct(data, header[4])) {
+		return false;
+	}
+
+	uint16_t	p	= header[2] | (header[3] << 8);
+	bool		ours = _active && (header[1] == _id);
+
+	switch (header[0]) {
+
+	case EBYTE_XFER_START:
+		if (header[4] >= 5) {
+			uint32_t size = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+
+			// same transfer again, tell the sender what is already here
+			if (ours && (size == _size) && (data[4] == _blockSize)) {
+				if (_count) {
+					SendStatus();
+				}
+			}
+			else if ((p != 0) && (p <= _maxBlocks)) {
+				memset(_received, 0, BitmapBytes());
+				_id			= header[1];
+				_size		= size;
+				_blockSize	= data[4];
+				_blocks		= p;
+				_count		= 0;
+				_active		= true;
+			}
+			else {
+				_active = false;
+			}
+		}
+		break;
+
+	case EBYTE_XFER_DATA:
+		if (ours && (p < _blocks)) {
+			// a corrupt or foreign block must not write over its neighbour or past the end
+			if ((header[4] > _blockSize) || (((uint32_t)p * _blockSize + header[4]) > _size)) {
+				Rejected++;
+			}
+			else if (GetBit(_received, p)) {
+				Duplicates++;
+			}
+			else {
+				_write((uint32_t)p * _blockSize, data, header[4]);
+				SetBit(_received, p, true);
+				_count++;
+			}
+		}
+		break;
+
+	case EBYTE_XFER_END:
+		if (ours) {
+			SendStatus();
+		}
+		break;
+
+	default:
+		break;
+	}
+	return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+/*
+  Bulk transfer (firmware images, log files) over an EBYTE link
+
+  SendStruct waits for the module and then 20ms more after every call, so the channel sits idle
+  between chunks. The sender here writes full sub packets back to back while the module's buffer has
+  room, working out the room from the bytes written, the air data rate and the AUX pin, so the module
+  always has the next sub packet queued.
+
+  The data is split into blocks of one sub packet less the 5 byte header. The receiver keeps a bitmap
+  of the blocks it has. At the end, or when a transfer with the same id is started again, it sends the
+  bitmap back and the sender sends only the missing blocks, so an interrupted transfer resumes where it
+  stopped. To survive a receiver reset save Bitmap() and call Restore() after the restart.
+
+  Frames, all start with the same 5 byte header [type][transfer id][p lo][p hi][payload length]
+	START	p = block count			payload = size (4 bytes, little endian), block size
+	DATA	p = block number		payload = block data
+	STATUS	p = first block in map	payload = bitmap, bit set = block received
+	END		p = block count			no payload
+
+  Usage
+	EBYTEBulkSender<512> Sender(&Transceiver);					// up to 512 blocks (100K at 195 bytes)
+	Sender.Begin(1, ImageSize, ReadImage);
+	while (Sender.Poll()) {}
+	Serial.print(Sender.Throughput()); Serial.print(" of "); Serial.println(Sender.MaxThroughput());
+
+	EBYTEBulkReceiver<512> Receiver(&Transceiver, WriteImage);
+	loop(): Receiver.Poll(); if (Receiver.Complete()) ...
+
+  While a transfer runs the link should carry nothing else
+*/
+
+#include "EBYTE_E220.h"
+
+#define EBYTE_XFER_START	0xB0
+#define EBYTE_XFER_DATA		0xB1
+#define EBYTE_XFER_STATUS	0xB2
+#define EBYTE_XFER_END		0xB3
+
+#define EBYTE_XFER_HEADER	5
+#define EBYTE_XFER_RETRIES	3
+
+enum XFER_STATE {
+	XFER_IDLE		= 0,
+	XFER_START		= 1,		// START to be sent
+	XFER_RESUME		= 2,		// waiting for the receiver to report blocks it already has
+	XFER_SENDING	= 3,
+	XFER_WAIT		= 4,		// END sent, waiting for the receiver's bitmap
+	XFER_DONE		= 5,
+	XFER_FAILED		= 6			// no answer from the receiver
+};
+
+// fills len bytes of the data at offset, returns the bytes filled
+typedef uint8_t (*ebyteReadFunc) (uint32_t offset, uint8_t *data, uint8_t len);
+
+// stores len received bytes at offset
+typedef void (*ebyteWriteFunc) (uint32_t offset, const uint8_t *data, uint8_t len);
+
+class EBYTEBulkSenderBase {
+
+public:
+
+	// method to start a transfer of size bytes, false if it needs more blocks than the bitmap holds
+	bool		Begin(uint8_t id, uint32_t size, ebyteReadFunc read);
+
+	// method to move the transfer on, call as often as possible. Returns true while it is running
+	bool		Poll();
+
+	XFER_STATE	State();
+	uint16_t	Blocks();
+
+	// data bytes per second since Begin() (until done), and the most the air data rate allows
+	uint32_t	Throughput();
+	uint32_t	MaxThroughput();
+
+	uint32_t	BytesSent		= 0;	// data bytes written, resends included
+	uint16_t	BlocksResent	= 0;	// blocks the receiver reported missing
+
+protected:
+
+	EBYTEBulkSenderBase(EBYTE *radio, uint8_t *pending, uint16_t maxBlocks);
+
+private:
+
+	bool		Ready(uint16_t len);
+	bool		Sent();
+	bool		Write(uint8_t type, uint16_t p, const uint8_t *payload, uint8_t len);
+	bool		GetStatus();
+	void		WaitForStatus();
+
+	EBYTE			*_radio;
+	uint8_t			*_pending;				// bit set = block still to send
+	uint16_t		_maxBlocks;
+	uint16_t		_blocks		= 0;
+	uint16_t		_next		= 0;
+	uint8_t			_blockSize	= 0;
+	uint8_t			_id			= 0;
+	uint8_t			_retries	= 0;
+	uint32_t		_size		= 0;
+	ebyteReadFunc	_read		= nullptr;
+	XFER_STATE		_state		= XFER_IDLE;
+
+	uint16_t		_inFlight	= 0;		// bytes written the module has not sent yet (estimate)
+	unsigned long	_drained	= 0;		// micros() _inFlight was last updated
+	unsigned long	_written	= 0;		// micros() of the last write
+	uint8_t			_lastLen	= 0;		// bytes of the last write
+
+	unsigned long	_started	= 0;		// millis() of Begin()
+	unsigned long	_finished	= 0;		// millis() the transfer completed
+	unsigned long	_waitStart	= 0;
+	unsigned long	_waitFor	= 0;
+
+};
+
+template <uint16_t MaxBlocks>
+class EBYTEBulkSender : public EBYTEBulkSenderBase {
+
+public:
+
+	EBYTEBulkSender(EBYTE *radio) : EBYTEBulkSenderBase(radio, _map, MaxBlocks) {}
+
+private:
+
+	uint8_t _map[(MaxBlocks + 7) / 8];
+
+};
+
+class EBYTEBulkReceiverBase {
+
+public:
+
+	// method to handle one frame if one is waiting, returns true if a frame was handled
+	bool		Poll();
+
+	// true once every block of the current transfer has been received
+	bool		Complete();
+
+	uint8_t		Id();
+	uint32_t	Size();
+	uint16_t	BlocksReceived();
+
+	// the received bitmap, save it with Id(), Size() and BlockSize() to resume after a restart
+	uint8_t		*Bitmap();
+	uint16_t	BitmapBytes();
+	uint8_t		BlockSize();
+
+	// method to continue a transfer after a restart, Bitmap() must already hold the saved bitmap
+	bool		Restore(uint8_t id, uint32_t size, uint8_t blockSize);
+
+	uint16_t	Duplicates	= 0;		// blocks received again
+	uint16_t	Rejected	= 0;		// blocks longer than a block, or reaching past the end
+
+protected:
+
+	EBYTEBulkReceiverBase(EBYTE *radio, uint8_t *received, uint16_t maxBlocks, ebyteWriteFunc write);
+
+private:
+
+	void			SendStatus();
+
+	EBYTE			*_radio;
+	uint8_t			*_received;
+	uint16_t		_maxBlocks;
+	uint16_t		_blocks		= 0;
+	uint16_t		_count		= 0;
+	uint8_t			_blockSize	= 0;
+	uint8_t			_id			= 0;
+	uint32_t		_size		= 0;
+	bool			_active		= false;
+	ebyteWriteFunc	_write;
+
+};
+
+template <uint16_t MaxBlocks>
+class EBYTEBulkReceiver : public EBYTEBulkReceiverBase {
+
+public:
+
+	EBYTEBulkReceiver(EBYTE *radio, ebyteWriteFunc write) : EBYTEBulkReceiverBase(radio, _map, MaxBlocks, write) {}
+
+private:
+
+	uint8_t _map[(MaxBlocks + 7) / 8];
+
+};
@@ -0,0 +1,292 @@
+/*
+  Arduino core shim for Linux, see Arduino.h
+*/
+
+#include "Arduino.h"
+#include "EBYTE_Linux.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+ConsoleSerial Serial;
+ConsoleSerial SerialUSB;
+
+static EBYTEGpio	*gpio		= nullptr;
+static EBYTEClock	*timeSource	= nullptr;
+
+// attached interrupts, emulated by looking at their pins whenever the time or a pin is read
+#define SHIM_INTERRUPTS	4
+
+struct Interrupt {
+	uint8_t		pin;
+	int			mode;
+	int			level;
+	void		(*isr)();
+};
+
+static Interrupt	attached[SHIM_INTERRUPTS];
+static uint8_t		attachedCount	= 0;
+static bool			enabled			= true;
+static bool			servicing		= false;
+
+/*
+method to run the handler of every attached pin that changed as its mode asks, not from a handler
+*/
+static void Service() {
+
+	if (!attachedCount || !enabled || servicing || !gpio) {
+		return;
+	}
+	servicing = true;
+	for (uint8_t i = 0; i < attachedCount; i++) {
+
+		int level = gpio->Read(attached[i].pin);
+
+		if (level == attached[i].level) {
+			continue;
+		}
+		attached[i].level = level;
+		if ((attached[i].mode == CHANGE) || ((attached[i].mode == RISING) == (level == HIGH))) {
+			attached[i].isr();
+		}
+	}
+	servicing = false;
+}
+
+static uint64_t MonotonicMicros() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// times count from the first call, as they do from reset on a board
+static uint64_t Start() {
+	static uint64_t start = MonotonicMicros();
+	return start;
+}
+
+unsigned long millis() {
+	Service();
+	return (unsigned long)((timeSource ? timeSource->Micros() : MonotonicMicros() - Start()) / 1000);
+}
+
+unsigned long micros() {
+	Service();
+	return (unsigned long)(timeSource ? timeSource->Micros() : MonotonicMicros() - Start());
+}
+
+/*
+real waits sleep in slices while interrupts are attached, so edges are seen within one. Slices run
+to a deadline, the time each takes to wake up doesn't add up
+*/
+static void Sleep(uint64_t us) {
+
+	struct timespec	ts;
+	uint64_t		end = MonotonicMicros() + us;
+
+	if (timeSource) {
+		timeSource->Sleep(us);
+		Service();
+		return;
+	}
+	for (uint64_t now = MonotonicMicros(); now < end; now = MonotonicMicros()) {
+
+		uint64_t slice = (attachedCount && ((end - now) > 100)) ? 100 : (end - now);
+
+		ts.tv_sec	= slice / 1000000;
+		ts.tv_nsec	= (long)(slice % 1000000) * 1000L;
+		while (nanosleep(&ts, &ts) != 0) {
+		}
+		Service();
+	}
+}
+
+void delay(unsigned long ms) {
+	Sleep((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+	Sleep(us);
+}
+
+void yield() {
+}
+
+void SetClock(EBYTEClock *c) {
+	timeSource = c;
+}
+
+EBYTEClock *GetClock() {
+	return timeSource;
+}
+
+void SetGpio(EBYTEGpio *g) {
+	gpio = g;
+}
+
+EBYTEGpio *GetGpio() {
+	return gpio;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	if (gpio) {
+		gpio->Mode(pin, mode);
+	}
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+	if (gpio) {
+		gpio->Write(pin, val);
+	}
+}
+
+int digitalRead(uint8_t pin) {
+	Service();
+	return gpio ? gpio->Read(pin) : HIGH;
+}
+
+long random(long max) {
+	return (max <= 0) ? 0 : (long)(::random() % max);
+}
+
+long random(long min, long max) {
+	return (max <= min) ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+	srandom((unsigned int)seed);
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+
+	detachInterrupt(interrupt);
+	if (attachedCount < SHIM_INTERRUPTS) {
+		attached[attachedCount++] = { interrupt, mode, gpio ? gpio->Read(interrupt) : HIGH, isr };
+	}
+}
+
+void detachInterrupt(uint8_t interrupt) {
+
+	for (uint8_t i = 0; i < attachedCount; i++) {
+		if (attached[i].pin == interrupt) {
+			attached[i] = attached[--attachedCount];
+			return;
+		}
+	}
+}
+
+void noInterrupts() {
+	enabled = false;
+}
+
+void interrupts() {
+	enabled = true;
+	Service();
+}
+
+/*
+Print, formatted as the Arduino core does
+*/
+size_t Print::write(const uint8_t *buffer, size_t size) {
+
+	size_t n = 0;
+
+	while (size--) {
+		if (write(*buffer++) == 0) {
+			break;
+		}
+		n++;
+	}
+	return n;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+
+	char	buf[8 * sizeof(long) + 1];
+	char	*str = &buf[sizeof(buf) - 1];
+
+	*str = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = (c < 10) ? (c + '0') : (c + 'A' - 10);
+	} while (n);
+
+	return write(str);
+}
+
+size_t Print::print(const __FlashStringHelper *s)	{ return write((const char *)s); }
+size_t Print::print(const char *s)					{ return write(s); }
+size_t Print::print(char c)							{ return write((uint8_t)c); }
+size_t Print::print(unsigned char n, int base)		{ return print((unsigned long)n, base); }
+size_t Print::print(int n, int base)				{ return print((long)n, base); }
+size_t Print::print(unsigned int n, int base)		{ return print((unsigned long)n, base); }
+
+size_t Print::print(long n, int base) {
+
+	if ((base == 10) && (n < 0)) {
+		return print('-') + printNumber((unsigned long)-n, 10);
+	}
+	return printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	return (base == 0) ? write((uint8_t)n) : printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+
+	char buf[64];
+
+	snprintf(buf, sizeof(buf), "%.*f", digits, n);
+	return write(buf);
+}
+
+size_t Print::println(const __FlashStringHelper *s)	{ return print(s) + println(); }
+size_t Print::println(const char *s)				{ return print(s) + println(); }
+size_t Print::println(char c)						{ return print(c) + println(); }
+size_t Print::println(unsigned char n, int base)	{ return print(n, base) + println(); }
+size_t Print::println(int n, int base)				{ return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base)		{ return print(n, base) + println(); }
+size_t Print::println(long n, int base)				{ return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base)	{ return print(n, base) + println(); }
+size_t Print::println(double n, int digits)			{ return print(n, digits) + println(); }
+size_t Print::println()								{ return write("\r\n"); }
+
+size_t Stream::readBytes(uint8_t *buffer, size_t size) {
+
+	size_t			count = 0;
+	unsigned long	start = millis();
+
+	while (count < size) {
+
+		int c = read();
+
+		if (c >= 0) {
+			buffer[count++] = (uint8_t)c;
+			continue;
+		}
+
+		unsigned long waited = millis() - start;
+
+		if (waited >= _timeout) {
+			break;
+		}
+		waitAvailable(_timeout - waited);
+	}
+	return count;
+}
+
+size_t ConsoleSerial::write(uint8_t c) {
+	return fwrite(&c, 1, 1, stderr);
+}
+
+size_t ConsoleSerial::write(const uint8_t *buffer, size_t size) {
+	return fwrite(buffer, 1, size, stderr);
+}
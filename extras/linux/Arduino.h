@@ -0,0 +1,172 @@
+#pragma once
+/*
+  Arduino core shim for Linux
+
+  Just enough of the Arduino API for the EBYTE library to build and run as a Linux program: time from
+  CLOCK_MONOTONIC, Print/Stream, Serial and SerialUSB on stderr, and pins through a GPIO HAL
+  (EBYTEGpio, EBYTE_Linux.h). The streams the modules are on are EBYTESerial (EBYTE_Linux.h)
+
+  Interrupts are emulated: attached pins are looked at whenever the program reads the time or a pin,
+  and every 100us of delay(), so an edge is handled late by as long as the program goes without doing
+  any of those. Handlers run from those calls, never from another thread. Up to 4 pins
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool	boolean;
+
+#define HIGH			1
+#define LOW				0
+
+#define INPUT			0
+#define OUTPUT			1
+#define INPUT_PULLUP	2
+
+#define CHANGE			1
+#define FALLING			2
+#define RISING			3
+
+#define DEC				10
+#define HEX				16
+#define OCT				8
+#define BIN				2
+
+unsigned long	millis();
+unsigned long	micros();
+void			delay(unsigned long ms);
+void			delayMicroseconds(unsigned int us);
+void			yield();
+
+void			pinMode(uint8_t pin, uint8_t mode);
+void			digitalWrite(uint8_t pin, uint8_t val);
+int				digitalRead(uint8_t pin);
+#define			digitalWriteFast(pin, val)	digitalWrite((pin), (val))
+#define			digitalReadFast(pin)		digitalRead((pin))
+
+long			random(long max);
+long			random(long min, long max);
+void			randomSeed(unsigned long seed);
+
+#define			digitalPinToInterrupt(p)	(p)
+void			attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void			detachInterrupt(uint8_t interrupt);
+void			noInterrupts();
+void			interrupts();
+
+class __FlashStringHelper;
+#define F(s)	(reinterpret_cast<const __FlashStringHelper *>(s))
+
+class Print {
+
+public:
+
+	virtual ~Print() {}
+
+	virtual size_t	write(uint8_t c) = 0;
+	virtual size_t	write(const uint8_t *buffer, size_t size);
+	size_t			write(const char *s)	{ return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+	virtual int		availableForWrite()		{ return 0; }
+	virtual void	flush()					{}
+
+	size_t	print(const __FlashStringHelper *s);
+	size_t	print(const char *s);
+	size_t	print(char c);
+	size_t	print(unsigned char n, int base = DEC);
+	size_t	print(int n, int base = DEC);
+	size_t	print(unsigned int n, int base = DEC);
+	size_t	print(long n, int base = DEC);
+	size_t	print(unsigned long n, int base = DEC);
+	size_t	print(double n, int digits = 2);
+
+	size_t	println(const __FlashStringHelper *s);
+	size_t	println(const char *s);
+	size_t	println(char c);
+	size_t	println(unsigned char n, int base = DEC);
+	size_t	println(int n, int base = DEC);
+	size_t	println(unsigned int n, int base = DEC);
+	size_t	println(long n, int base = DEC);
+	size_t	println(unsigned long n, int base = DEC);
+	size_t	println(double n, int digits = 2);
+	size_t	println();
+
+private:
+
+	size_t	printNumber(unsigned long n, uint8_t base);
+
+};
+
+class Stream : public Print {
+
+public:
+
+	virtual int		available() = 0;
+	virtual int		read() = 0;
+	virtual int		peek() = 0;
+
+	void			setTimeout(unsigned long ms)	{ _timeout = ms; }
+	unsigned long	getTimeout()					{ return _timeout; }
+
+	// reads until size bytes have come or the timeout passes, as on Arduino
+	size_t			readBytes(uint8_t *buffer, size_t size);
+	size_t			readBytes(char *buffer, size_t size)	{ return readBytes((uint8_t *)buffer, size); }
+
+protected:
+
+	// method to wait up to ms for data, streams over file descriptors block in poll() instead of spinning
+	virtual void	waitAvailable(unsigned long ms)	{ delay(ms ? 1 : 0); }
+
+	unsigned long	_timeout		= 1000;
+
+};
+
+// the Arduino serial monitor, written to stderr so stdout stays free for the program's own output
+class ConsoleSerial : public Stream {
+
+public:
+
+	void	begin(unsigned long) {}
+	int		available()				{ return 0; }
+	int		read()					{ return -1; }
+	int		peek()					{ return -1; }
+	size_t	write(uint8_t c);
+	size_t	write(const uint8_t *buffer, size_t size);
+	using	Print::write;
+	operator bool()					{ return true; }
+
+};
+
+extern ConsoleSerial Serial;
+extern ConsoleSerial SerialUSB;
+
+class elapsedMillis {
+
+public:
+
+	elapsedMillis(unsigned long val = 0)		{ _ms = millis() - val; }
+	operator unsigned long() const				{ return millis() - _ms; }
+	elapsedMillis &operator=(unsigned long val)	{ _ms = millis() - val; return *this; }
+
+private:
+
+	unsigned long _ms;
+
+};
+
+class elapsedMicros {
+
+public:
+
+	elapsedMicros(unsigned long val = 0)		{ _us = micros() - val; }
+	operator unsigned long() const				{ return micros() - _us; }
+	elapsedMicros &operator=(unsigned long val)	{ _us = micros() - val; return *this; }
+
+private:
+
+	unsigned long _us;
+
+};
@@ -0,0 +1,271 @@
+/*
+  Linux backend, see EBYTE_Linux.h
+*/
+
+#include "EBYTE_Linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+/*
+termios speed for a baud rate, B0 if there is none
+*/
+static speed_t Speed(uint32_t baud) {
+
+	switch (baud) {
+	case 1200:		return B1200;
+	case 2400:		return B2400;
+	case 4800:		return B4800;
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	}
+	return B0;
+}
+
+EBYTESerial::~EBYTESerial() {
+	Close();
+}
+
+bool EBYTESerial::Open(const char *path, uint32_t baud) {
+
+	Close();
+
+	_fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (_fd < 0) {
+		return false;
+	}
+	if (!SetBaud(baud)) {
+		Close();
+		return false;
+	}
+	tcflush(_fd, TCIOFLUSH);
+	return true;
+}
+
+void EBYTESerial::Close() {
+
+	if (_fd >= 0) {
+		close(_fd);
+	}
+	_fd		= -1;
+	_peeked	= -1;
+}
+
+/*
+method to set raw 8N1 at baud, also used as the auto baud callback when the module goes to program mode
+*/
+bool EBYTESerial::SetBaud(uint32_t baud) {
+
+	struct termios	tio;
+	speed_t			speed = Speed(baud);
+
+	if ((_fd < 0) || (speed == B0) || (tcgetattr(_fd, &tio) != 0)) {
+		return false;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag		|= CLOCAL | CREAD;
+	tio.c_cflag		&= ~(CSTOPB | CRTSCTS | PARENB);
+	tio.c_cc[VMIN]	= 0;
+	tio.c_cc[VTIME]	= 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	// drain first, changing speed under bytes still going out garbles them
+	tcdrain(_fd);
+	return tcsetattr(_fd, TCSANOW, &tio) == 0;
+}
+
+int EBYTESerial::Fd() {
+	return _fd;
+}
+
+int EBYTESerial::available() {
+
+	int n = 0;
+
+	if ((_fd < 0) || (ioctl(_fd, FIONREAD, &n) != 0)) {
+		return (_peeked >= 0) ? 1 : 0;
+	}
+	return n + ((_peeked >= 0) ? 1 : 0);
+}
+
+int EBYTESerial::read() {
+
+	uint8_t c;
+
+	if (_peeked >= 0) {
+		c		= (uint8_t)_peeked;
+		_peeked	= -1;
+		return c;
+	}
+	if ((_fd < 0) || (::read(_fd, &c, 1) != 1)) {
+		return -1;
+	}
+	return c;
+}
+
+int EBYTESerial::peek() {
+
+	if (_peeked < 0) {
+		_peeked = read();
+	}
+	return _peeked;
+}
+
+size_t EBYTESerial::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t EBYTESerial::write(const uint8_t *buffer, size_t size) {
+
+	size_t done = 0;
+
+	while ((_fd >= 0) && (done < size)) {
+
+		ssize_t n = ::write(_fd, buffer + done, size - done);
+
+		if (n > 0) {
+			done += n;
+		}
+		else if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+			struct pollfd p = { _fd, POLLOUT, 0 };
+			if (poll(&p, 1, (int)_timeout) <= 0) {
+				break;
+			}
+		}
+		else {
+			break;
+		}
+	}
+	return done;
+}
+
+void EBYTESerial::flush() {
+	if (_fd >= 0) {
+		tcdrain(_fd);
+	}
+}
+
+void EBYTESerial::waitAvailable(unsigned long ms) {
+
+	struct pollfd p = { _fd, POLLIN, 0 };
+
+	if (_fd < 0) {
+		delay(ms);
+		return;
+	}
+	poll(&p, 1, (int)ms);
+}
+
+/*
+GPIO character device, one line handle per pin requested as it is given a mode
+*/
+EBYTEGpioChip::EBYTEGpioChip(const char *chip) {
+
+	_chip = open(chip, O_RDWR | O_CLOEXEC);
+
+	for (uint8_t i = 0; i < EBYTE_GPIO_LINES; i++) {
+		_lines[i] = -1;
+	}
+}
+
+EBYTEGpioChip::~EBYTEGpioChip() {
+
+	for (uint8_t i = 0; i < EBYTE_GPIO_LINES; i++) {
+		if (_lines[i] >= 0) {
+			close(_lines[i]);
+		}
+	}
+	if (_chip >= 0) {
+		close(_chip);
+	}
+}
+
+bool EBYTEGpioChip::Ok() {
+	return _chip >= 0;
+}
+
+void EBYTEGpioChip::Mode(uint8_t pin, uint8_t mode) {
+
+	struct gpiohandle_request req;
+
+	if ((_chip < 0) || (pin >= EBYTE_GPIO_LINES)) {
+		return;
+	}
+	if (_lines[pin] >= 0) {
+		close(_lines[pin]);
+		_lines[pin] = -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.lineoffsets[0]	= pin;
+	req.lines			= 1;
+	req.flags			= (mode == OUTPUT) ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT;
+#ifdef GPIOHANDLE_REQUEST_BIAS_PULL_UP
+	if (mode == INPUT_PULLUP) {
+		req.flags |= GPIOHANDLE_REQUEST_BIAS_PULL_UP;
+	}
+#endif
+	strncpy(req.consumer_label, "ebyte", sizeof(req.consumer_label) - 1);
+
+	if (ioctl(_chip, GPIO_GET_LINEHANDLE_IOCTL, &req) == 0) {
+		_lines[pin] = req.fd;
+	}
+}
+
+void EBYTEGpioChip::Write(uint8_t pin, uint8_t val) {
+
+	struct gpiohandle_data data;
+
+	if ((pin >= EBYTE_GPIO_LINES) || (_lines[pin] < 0)) {
+		return;
+	}
+	memset(&data, 0, sizeof(data));
+	data.values[0] = val ? 1 : 0;
+	ioctl(_lines[pin], GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+}
+
+int EBYTEGpioChip::Read(uint8_t pin) {
+
+	struct gpiohandle_data data;
+
+	if ((pin >= EBYTE_GPIO_LINES) || (_lines[pin] < 0)) {
+		return HIGH;
+	}
+	memset(&data, 0, sizeof(data));
+	if (ioctl(_lines[pin], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) != 0) {
+		return HIGH;
+	}
+	return data.values[0] ? HIGH : LOW;
+}
+
+/*
+simulated pins, everything starts HIGH as the AUX pull up would have it
+*/
+EBYTEGpioSim::EBYTEGpioSim() {
+	for (uint8_t i = 0; i < EBYTE_GPIO_LINES; i++) {
+		_level[i] = HIGH;
+	}
+}
+
+void EBYTEGpioSim::Mode(uint8_t, uint8_t) {
+}
+
+void EBYTEGpioSim::Write(uint8_t pin, uint8_t val) {
+	if (pin < EBYTE_GPIO_LINES) {
+		_level[pin] = val ? HIGH : LOW;
+	}
+}
+
+int EBYTEGpioSim::Read(uint8_t pin) {
+	return (pin < EBYTE_GPIO_LINES) ? _level[pin].load() : HIGH;
+}
@@ -0,0 +1,132 @@
+#pragma once
+/*
+  Linux backend: modules on serial ports, M0/M1/AUX on GPIO lines
+
+  EBYTESerial is a Stream over a termios file descriptor (USB-UART adapter, on board UART or a pseudo
+  terminal). The descriptor is non-blocking: available() and read() never wait, readBytes() waits in
+  poll() up to the stream timeout, write() waits in poll() only while the kernel buffer is full. Fd()
+  is there for event loops (epoll) that read and write the port directly.
+
+  Time and pins can be replaced: SetClock() runs millis(), micros() and delay() on another clock (a
+  virtual one when replaying a capture, EBYTE_Replay.h).
+
+  Pins go through a GPIO HAL. EBYTEGpioChip drives the lines of one /dev/gpiochipN through the GPIO
+  character device, the EBYTE pin numbers being the line offsets. EBYTEGpioSim keeps levels in memory
+  for simulated modules (EBYTE_Sim.h). Pin 255 (none) is ignored by both.
+
+  Usage
+	EBYTEGpioChip Gpio("/dev/gpiochip0");
+	SetGpio(&Gpio);
+	EBYTESerial Port;
+	Port.Open("/dev/ttyUSB0", 9600);
+	EBYTE Transceiver(&Port, 17, 27, 22);		// M0, M1, AUX line offsets
+	Transceiver.init();
+*/
+
+#include "Arduino.h"
+
+#include <atomic>
+
+class EBYTESerial : public Stream {
+
+public:
+
+	~EBYTESerial();
+
+	// method to open a serial device raw 8N1 at baud, false if it can't be opened or the rate is unknown
+	bool	Open(const char *path, uint32_t baud = 9600);
+	void	Close();
+	bool	SetBaud(uint32_t baud);
+	int		Fd();
+
+	int		available();
+	int		read();
+	int		peek();
+	size_t	write(uint8_t c);
+	size_t	write(const uint8_t *buffer, size_t size);
+	using	Print::write;
+
+	// waits until everything written has left the UART
+	void	flush();
+
+protected:
+
+	void	waitAvailable(unsigned long ms);
+
+private:
+
+	int		_fd			= -1;
+	int		_peeked		= -1;
+
+};
+
+class EBYTEGpio {
+
+public:
+
+	virtual ~EBYTEGpio() {}
+
+	virtual void	Mode(uint8_t pin, uint8_t mode) = 0;
+	virtual void	Write(uint8_t pin, uint8_t val) = 0;
+	virtual int		Read(uint8_t pin) = 0;
+
+};
+
+// method to route pinMode/digitalWrite/digitalRead, nullptr makes them do nothing (and read HIGH)
+void		SetGpio(EBYTEGpio *gpio);
+EBYTEGpio	*GetGpio();
+
+class EBYTEClock {
+
+public:
+
+	virtual ~EBYTEClock() {}
+
+	// microseconds since the clock started, and waiting us of them
+	virtual uint64_t	Micros() = 0;
+	virtual void		Sleep(uint64_t us) = 0;
+
+};
+
+// method to run millis/micros/delay on another clock (EBYTEReplay), nullptr puts back CLOCK_MONOTONIC
+void		SetClock(EBYTEClock *clock);
+EBYTEClock	*GetClock();
+
+#define EBYTE_GPIO_LINES	64
+
+class EBYTEGpioChip : public EBYTEGpio {
+
+public:
+
+	EBYTEGpioChip(const char *chip = "/dev/gpiochip0");
+	~EBYTEGpioChip();
+
+	bool	Ok();
+
+	void	Mode(uint8_t pin, uint8_t mode);
+	void	Write(uint8_t pin, uint8_t val);
+	int		Read(uint8_t pin);
+
+private:
+
+	int		_chip;
+	int		_lines[EBYTE_GPIO_LINES];		// line handle per offset, -1 until requested
+
+};
+
+class EBYTEGpioSim : public EBYTEGpio {
+
+public:
+
+	EBYTEGpioSim();
+
+	void	Mode(uint8_t pin, uint8_t mode);
+	void	Write(uint8_t pin, uint8_t val);
+	int		Read(uint8_t pin);
+
+private:
+
+	// written by the program and the simulator thread
+	std::atomic<uint8_t>	_level[EBYTE_GPIO_LINES];
+
+};
@@ -0,0 +1,345 @@
+/*
+  Replay, see EBYTE_Replay.h
+*/
+
+#include "EBYTE_Replay.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+bool EBYTEReplay::Open(const char *path) {
+
+	std::vector<uint8_t>	log;
+	uint8_t					chunk[4096];
+	size_t					n;
+	FILE					*f = fopen(path, "rb");
+
+	if (!f) {
+		return false;
+	}
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		log.insert(log.end(), chunk, chunk + n);
+	}
+	fclose(f);
+	return Load(log.data(), log.size());
+}
+
+/*
+method to turn the records into what the replay steps through: bytes each way, pin levels, and the
+order M0 and M1 are expected to change in
+*/
+bool EBYTEReplay::Load(const uint8_t *log, size_t len) {
+
+	size_t		i	= EBYTE_CAPTURE_HEADER;
+	uint64_t	at	= 0;
+	uint8_t		start;
+
+	if ((len < EBYTE_CAPTURE_HEADER) || (memcmp(log, "EBYC", 4) != 0) || (log[4] != EBYTE_CAPTURE_VERSION)) {
+		return false;
+	}
+	_pins[0] = log[5];
+	_pins[1] = log[6];
+	_pins[2] = log[7];
+
+	_rx.clear();
+	_tx.clear();
+	_levels.clear();
+
+	while (i < len) {
+
+		uint8_t		tag		= log[i++];
+		uint8_t		count	= (tag & ~EBYTE_CAPTURE_TYPE) + 1;
+		uint64_t	delta	= 0;
+		uint8_t		shift	= 0;
+
+		do {
+			if ((i >= len) || (shift > 28)) {
+				return true;
+			}
+			delta	|= (uint64_t)(log[i] & 0x7F) << shift;
+			shift	+= 7;
+		} while (log[i++] & 0x80);
+		at += delta;
+
+		switch (tag & EBYTE_CAPTURE_TYPE) {
+		case EBYTE_CAPTURE_RX:
+		case EBYTE_CAPTURE_TX:
+			if ((i + count) > len) {
+				return true;
+			}
+			for (uint8_t j = 0; j < count; j++) {
+				Step s = { at, log[i + j] };
+				((tag & EBYTE_CAPTURE_TYPE) == EBYTE_CAPTURE_RX) ? _rx.push_back(s) : _tx.push_back(s);
+			}
+			i += count;
+			break;
+
+		case EBYTE_CAPTURE_PINS:
+			_levels.push_back({ at, (uint8_t)(tag & 0x07) });
+			break;
+
+		default:
+			// a later version, nothing after it can be trusted
+			return true;
+		}
+	}
+
+	// M0 and M1 changes after the levels at the start
+	start = _levels.empty() ? 0x07 : _levels[0].value;
+	for (uint8_t p = 0; p < 2; p++) {
+
+		uint8_t level = (start >> p) & 1;
+
+		_expect[p].clear();
+		for (size_t j = 1; j < _levels.size(); j++) {
+			if (((_levels[j].value >> p) & 1) != level) {
+				level ^= 1;
+				_expect[p].push_back({ _levels[j].at, level });
+			}
+		}
+	}
+	return true;
+}
+
+uint8_t EBYTEReplay::PinM0() {
+	return _pins[0];
+}
+
+uint8_t EBYTEReplay::PinM1() {
+	return _pins[1];
+}
+
+uint8_t EBYTEReplay::PinAUX() {
+	return _pins[2];
+}
+
+void EBYTEReplay::Begin() {
+
+	_now			= 0;
+	_shift			= 0;
+	_rxNext			= 0;
+	_txNext			= 0;
+	_levelNext		= 0;
+	_expectNext[0]	= 0;
+	_expectNext[1]	= 0;
+	_buffer.clear();
+
+	_level			= _levels.empty() ? 0x07 : _levels[0].value;
+	_written[0]		= _level & 1;
+	_written[1]		= (_level >> 1) & 1;
+
+	BytesIn			= 0;
+	BytesOut		= 0;
+	Mismatches		= 0;
+	PinMismatches	= 0;
+	MaxSkew			= 0;
+
+	_gpio = GetGpio();
+	SetGpio(this);
+	SetClock(this);
+	Advance();
+}
+
+void EBYTEReplay::End() {
+	SetClock(nullptr);
+	SetGpio(_gpio);
+}
+
+bool EBYTEReplay::Done() {
+	return (_rxNext == _rx.size()) && _buffer.empty() && (_txNext == _tx.size());
+}
+
+uint64_t EBYTEReplay::Now() {
+	return _now;
+}
+
+uint64_t EBYTEReplay::Length() {
+
+	uint64_t end = 0;
+
+	end = _rx.empty() ? end : std::max(end, _rx.back().at);
+	end = _tx.empty() ? end : std::max(end, _tx.back().at);
+	end = _levels.empty() ? end : std::max(end, _levels.back().at);
+	return end;
+}
+
+/*
+method to play everything captured up to now. Nothing captured after a write the program hasn't made
+yet is played, it may be the module's answer to it
+*/
+void EBYTEReplay::Advance() {
+
+	uint64_t until	= (_now > _shift) ? (_now - _shift) : 0;
+	uint64_t gate	= (_txNext < _tx.size()) ? _tx[_txNext].at : UINT64_MAX;
+
+	while ((_rxNext < _rx.size()) && (_rx[_rxNext].at <= until) && (_rx[_rxNext].at < gate)) {
+		_buffer.push_back(_rx[_rxNext++].value);
+	}
+	while ((_levelNext < _levels.size()) && (_levels[_levelNext].at <= until) && (_levels[_levelNext].at < gate)) {
+		_level = _levels[_levelNext++].value;
+	}
+}
+
+/*
+method to note how far from its captured time something was done. A write keeps the replay in step:
+made early, the clock moves on to the captured time if that is no more than Snap ahead; made late,
+the rest of the capture moves later with it. M0 and M1 are captured when seen, maybe late, and don't
+*/
+void EBYTEReplay::Skew(uint64_t at, bool write) {
+
+	uint64_t t		= at + _shift;
+	uint64_t skew	= (t > _now) ? (t - _now) : (_now - t);
+
+	if (skew > MaxSkew) {
+		MaxSkew = (skew > UINT32_MAX) ? UINT32_MAX : (uint32_t)skew;
+	}
+	if (!write) {
+		return;
+	}
+	if (t < _now) {
+		_shift += _now - t;
+	}
+	else if (skew <= Snap) {
+		_now = t;
+	}
+}
+
+/*
+method for a read finding nothing: the capture saw the next bytes at a read, if that was no more than
+Snap ahead and nothing the program wrote before it is still to come, this read is the one
+*/
+void EBYTEReplay::Poll() {
+
+	uint64_t at;
+
+	Advance();
+	if (!_buffer.empty() || (_rxNext >= _rx.size())) {
+		return;
+	}
+	at = _rx[_rxNext].at;
+	if ((_txNext < _tx.size()) && (_tx[_txNext].at <= at)) {
+		return;
+	}
+	for (uint8_t p = 0; p < 2; p++) {
+		if ((_expectNext[p] < _expect[p].size()) && (_expect[p][_expectNext[p]].at <= at)) {
+			return;
+		}
+	}
+	if ((at + _shift - _now) <= Snap) {
+		_now = at + _shift;
+		Advance();
+	}
+}
+
+uint64_t EBYTEReplay::Micros() {
+	_now += Tick;
+	Advance();
+	return _now;
+}
+
+void EBYTEReplay::Sleep(uint64_t us) {
+	_now += us;
+	Advance();
+}
+
+/*
+readBytes() waiting: straight to the next captured byte if it comes within ms
+*/
+void EBYTEReplay::waitAvailable(unsigned long ms) {
+
+	uint64_t until = _now + (uint64_t)ms * 1000;
+
+	if (!_buffer.empty()) {
+		return;
+	}
+	if ((_rxNext < _rx.size()) && ((_txNext >= _tx.size()) || (_rx[_rxNext].at < _tx[_txNext].at))) {
+		until = std::min(until, _rx[_rxNext].at + _shift);
+	}
+	_now = (until > _now) ? until : _now;
+	Advance();
+}
+
+int EBYTEReplay::available() {
+	Poll();
+	return (int)_buffer.size();
+}
+
+int EBYTEReplay::read() {
+
+	uint8_t c;
+
+	Poll();
+	if (_buffer.empty()) {
+		return -1;
+	}
+	c = _buffer.front();
+	_buffer.pop_front();
+	BytesIn++;
+	return c;
+}
+
+int EBYTEReplay::peek() {
+	Poll();
+	return _buffer.empty() ? -1 : _buffer.front();
+}
+
+size_t EBYTEReplay::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t EBYTEReplay::write(const uint8_t *buffer, size_t size) {
+
+	Advance();
+	for (size_t i = 0; i < size; i++) {
+		if ((_txNext >= _tx.size()) || (_tx[_txNext].value != buffer[i])) {
+			Mismatches++;
+		}
+		if (_txNext < _tx.size()) {
+			Skew(_tx[_txNext++].at, true);
+		}
+	}
+	Advance();
+	BytesOut += size;
+	return size;
+}
+
+void EBYTEReplay::Mode(uint8_t, uint8_t) {
+}
+
+/*
+M0 and M1 as the program sets them, each change checked against the next captured one
+*/
+void EBYTEReplay::Write(uint8_t pin, uint8_t val) {
+
+	Advance();
+	val = val ? HIGH : LOW;
+
+	for (uint8_t p = 0; p < 2; p++) {
+		if ((pin != _pins[p]) || (val == _written[p])) {
+			continue;
+		}
+		_written[p] = val;
+		if ((_expectNext[p] >= _expect[p].size()) || (_expect[p][_expectNext[p]].value != val)) {
+			PinMismatches++;
+		}
+		if (_expectNext[p] < _expect[p].size()) {
+			Skew(_expect[p][_expectNext[p]++].at, false);
+		}
+	}
+}
+
+int EBYTEReplay::Read(uint8_t pin) {
+
+	Advance();
+	if (pin == _pins[2]) {
+		return (_level >> 2) & 1;
+	}
+	if (pin == _pins[0]) {
+		return _written[0];
+	}
+	if (pin == _pins[1]) {
+		return _written[1];
+	}
+	return HIGH;
+}
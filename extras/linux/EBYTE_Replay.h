@@ -0,0 +1,118 @@
+#pragma once
+/*
+  Replay: feeding a capture (EBYTE_Capture.h) back into EBYTE on a virtual clock
+
+  EBYTEReplay stands in for the module's port, its pins and the clock. Time starts at 0 at Begin()
+  and only moves when the program looks at it: delay() moves it by the delay, every millis() or
+  micros() call by Tick, readBytes() waiting for data straight to the next captured byte. Bytes the
+  module gave become available, and AUX changes level, at the times they were captured, so the
+  program sees what it saw in the field and runs the same way every time, as fast as the CPU allows.
+
+  The program doesn't run at the same speed on the virtual clock as it did for real, and would drift
+  out of step with the capture and lose the races it shows (bytes read just before AUX fell, a write
+  just before the module went busy). So nothing captured after a write is played before the program
+  makes that write; a write made late moves the rest of the capture later with it, one made early,
+  and a read finding nothing, move the clock on to their captured time if it is at most Snap ahead.
+
+  What the program writes is checked against the capture: bytes in order (Mismatches), M0 and M1
+  levels in order (PinMismatches), and how far from the captured time each was written (MaxSkew).
+  A replay that runs as the capture did ends Done() with no mismatches; timing changes in the
+  library show as skew, behaviour changes as mismatches.
+
+  Usage
+	EBYTEReplay Replay;
+	Replay.Open("radio.cap");
+	EBYTE Transceiver(&Replay, Replay.PinM0(), Replay.PinM1(), Replay.PinAUX());
+	Replay.Begin();
+	... run the code that made the capture, until Replay.Done()
+	Replay.End();
+*/
+
+#include "Arduino.h"
+#include "EBYTE_Linux.h"
+#include "EBYTE_Capture.h"
+
+#include <deque>
+#include <vector>
+
+class EBYTEReplay : public Stream, public EBYTEGpio, public EBYTEClock {
+
+public:
+
+	// method to load a capture, false if it can't be read or isn't one. A cut off last record is dropped
+	bool		Open(const char *path);
+	bool		Load(const uint8_t *log, size_t len);
+
+	// pins the capture was made with
+	uint8_t		PinM0();
+	uint8_t		PinM1();
+	uint8_t		PinAUX();
+
+	// method to start at the beginning of the capture, taking over the clock and the pins
+	void		Begin();
+
+	// method to give the clock and the pins back
+	void		End();
+
+	// true when all captured bytes have been read and all captured writes made
+	bool		Done();
+
+	// us of virtual time since Begin(), and of the capture
+	uint64_t	Now();
+	uint64_t	Length();
+
+	uint32_t	Tick			= 1;		// us the clock moves on every reading
+	uint32_t	Snap			= 2000;		// us the clock may jump to line up with the capture
+
+	uint32_t	BytesIn			= 0;
+	uint32_t	BytesOut		= 0;
+	uint32_t	Mismatches		= 0;		// bytes written that differ from the capture, or beyond it
+	uint32_t	PinMismatches	= 0;
+	uint32_t	MaxSkew			= 0;		// us between a write and its captured time
+
+	int			available();
+	int			read();
+	int			peek();
+	size_t		write(uint8_t c);
+	size_t		write(const uint8_t *buffer, size_t size);
+	using		Print::write;
+
+	void		Mode(uint8_t pin, uint8_t mode);
+	void		Write(uint8_t pin, uint8_t val);
+	int			Read(uint8_t pin);
+
+	uint64_t	Micros();
+	void		Sleep(uint64_t us);
+
+protected:
+
+	void		waitAvailable(unsigned long ms);
+
+private:
+
+	struct Step {
+		uint64_t	at;
+		uint8_t		value;
+	};
+
+	void		Advance();
+	void		Poll();
+	void		Skew(uint64_t at, bool write);
+
+	uint8_t				_pins[3]	= { 255, 255, 255 };	// M0, M1, AUX
+	std::vector<Step>	_rx;								// bytes from the module
+	std::vector<Step>	_tx;								// bytes written to it
+	std::vector<Step>	_levels;							// pin levels, bit 0 M0, 1 M1, 2 AUX
+	std::vector<Step>	_expect[2];							// M0 and M1 changes
+	size_t				_rxNext		= 0;
+	size_t				_txNext		= 0;
+	size_t				_levelNext	= 0;
+	size_t				_expectNext[2];
+	std::deque<uint8_t>	_buffer;							// available to read
+	uint8_t				_level		= 0x07;					// captured levels now
+	uint8_t				_written[2];						// M0, M1 as the program set them
+	uint64_t			_now		= 0;
+	uint64_t			_shift		= 0;						// us the capture runs behind, from late writes
+	EBYTEGpio			*_gpio		= nullptr;				// given back at End()
+
+};
@@ -0,0 +1,519 @@
+/*
+  Simulated E220 module, see EBYTE_Sim.h
+*/
+
+#include "EBYTE_Sim.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+/*
+factory settings: address 0, 9600 8N1, 2.4k air rate, 200 byte sub packets, channel 18, no RSSI byte
+*/
+EBYTESimModule::EBYTESimModule(EBYTESimMedium *medium) {
+
+	static const uint8_t defaults[8] = { 0x00, 0x00, 0x62, 0x00, 0x12, 0x03, 0x00, 0x00 };
+
+	_medium = medium;
+	memcpy(_reg, defaults, sizeof(_reg));
+}
+
+void EBYTESimModule::SetMedium(EBYTESimMedium *medium) {
+	_medium = medium;
+}
+
+void EBYTESimModule::SetPins(bool m0, bool m1, uint64_t now) {
+
+	uint8_t mode = (m1 ? 2 : 0) | (m0 ? 1 : 0);
+
+	if (mode == _mode) {
+		return;
+	}
+	// anything half written is dropped with the old mode
+	_mode		= mode;
+	_inLen		= 0;
+	_auxUntil	= now + EBYTE_SIM_MODE_US;
+}
+
+void EBYTESimModule::Input(const uint8_t *data, size_t len, uint64_t now) {
+
+	if (_inLen == 0) {
+		_firstIn = now;
+	}
+	while (len--) {
+		if (_inLen < sizeof(_in)) {
+			_in[_inLen++] = *data;
+		}
+		else {
+			Overflows++;
+		}
+		data++;
+	}
+	_lastIn = now;
+
+	if (_mode == 3) {
+		Command(now);
+	}
+}
+
+size_t EBYTESimModule::Output(uint8_t *data, size_t max) {
+
+	size_t n = (_out.size() < max) ? _out.size() : max;
+
+	memcpy(data, _out.data(), n);
+	_out.erase(_out.begin(), _out.begin() + n);
+	return n;
+}
+
+size_t EBYTESimModule::OutputPending() {
+	return _out.size();
+}
+
+bool EBYTESimModule::Aux(uint64_t now) {
+
+	if ((now < _auxUntil) || (now < _txEnd)) {
+		return false;
+	}
+	// still holding bytes to send
+	return (_mode == 3) || (_inLen == 0);
+}
+
+void EBYTESimModule::Poll(uint64_t now) {
+
+	// three bytes' time without data ends a packet
+	uint64_t gap = 30000000ULL / UartBps();
+
+	if (_mode == 3) {
+		if (_inLen && ((now - _lastIn) >= 50000)) {
+			_inLen = 0;
+		}
+		return;
+	}
+	if (_mode == 2) {
+		// WOR receive can't send
+		_inLen = 0;
+		return;
+	}
+	if ((_inLen == 0) || (now < _txEnd) || (now < _lbtUntil)) {
+		return;
+	}
+
+	bool ended = (now - _lastIn) >= gap;
+
+	// the ambient RSSI command, when REG1 enables it
+	if (ended && (_inLen == 6) && (_reg[3] & 0x20) && (_in[0] == 0xC0) && (_in[1] == 0xC1) && (_in[2] == 0xC2) && (_in[3] == 0xC3)) {
+
+		uint8_t values[2] = { (uint8_t)(_medium ? _medium->Noise(this, Channel(), now) : 0), _lastRSSI };
+		uint8_t start	  = _in[4];
+		uint8_t len		  = _in[5];
+
+		_out.push_back(0xC1);
+		_out.push_back(start);
+		_out.push_back(len);
+		for (uint8_t i = start; i < (uint8_t)(start + len); i++) {
+			_out.push_back((i < 2) ? values[i] : 0);
+		}
+		_inLen = 0;
+		return;
+	}
+
+	if (ended || (_inLen >= (SubPacketBytes() + (Fixed() ? 3 : 0)))) {
+		Send(now);
+	}
+}
+
+uint64_t EBYTESimModule::NextPoll(uint64_t now) {
+
+	uint64_t gap = 30000000ULL / UartBps();
+	uint64_t next;
+
+	if (_inLen == 0) {
+		return UINT64_MAX;
+	}
+	if (_mode == 3) {
+		return _lastIn + 50000;
+	}
+	if (_mode == 2) {
+		return now;
+	}
+
+	// a full sub packet goes without waiting for the gap
+	next = (_inLen >= (SubPacketBytes() + (Fixed() ? 3 : 0))) ? now : (_lastIn + gap);
+	next = std::max(next, _txEnd);
+	next = std::max(next, _lbtUntil);
+	return std::max(next, now);
+}
+
+uint64_t EBYTESimModule::AuxHighAt(uint64_t now) {
+
+	uint64_t at = std::max(_auxUntil, _txEnd);
+
+	// bytes still to send keep it low until they have gone
+	if ((_mode != 3) && _inLen) {
+		at = std::max(at, NextPoll(now));
+	}
+	return std::max(at, now);
+}
+
+/*
+method to send one sub packet of what is buffered. In fixed mode the first three bytes are the
+address and channel it goes to, and stay for the sub packets after it
+*/
+void EBYTESimModule::Send(uint64_t now) {
+
+	EBYTESimFrame	f;
+	uint8_t			header = Fixed() ? 3 : 0;
+
+	if (_inLen <= header) {
+		_inLen = 0;
+		return;
+	}
+
+	f.from		= this;
+	f.to		= header ? (uint16_t)((_in[0] << 8) | _in[1]) : Address();
+	f.channel	= header ? _in[2] : Channel();
+
+	if (LBT() && _medium && _medium->Busy(this, f.channel, now)) {
+		_lbtUntil = now + EBYTE_SIM_LBT_US;
+		Deferred++;
+		return;
+	}
+
+	f.wor		= (_mode == 1);
+	f.key[0]	= _reg[6];
+	f.key[1]	= _reg[7];
+	f.rate		= AirRate();
+	f.power		= Power();
+	f.queued	= _firstIn;
+	f.len		= ((_inLen - header) < SubPacketBytes()) ? (_inLen - header) : SubPacketBytes();
+	f.start		= now;
+	f.end		= now + AirTimeMicros(f.len) + (f.wor ? WorMicros() : 0);
+	memcpy(f.data, &_in[header], f.len);
+
+	memmove(&_in[header], &_in[header + f.len], _inLen - header - f.len);
+	_inLen -= f.len;
+	if (_inLen == header) {
+		_inLen = 0;
+	}
+	// what is left was written no earlier than this sub packet went
+	_firstIn = std::max(_firstIn, now);
+
+	_txStart	= f.start;
+	_txEnd		= f.end;
+	Sent++;
+
+	if (_medium) {
+		_medium->Transmit(f);
+	}
+}
+
+/*
+method to answer the register commands in program mode: C0/C2 write and C1 read, each answered with
+C1, the start, the length and the registers. The crypt key reads back as 0
+*/
+void EBYTESimModule::Command(uint64_t now) {
+
+	while (_inLen >= 3) {
+
+		uint8_t cmd		= _in[0];
+		uint8_t start	= _in[1];
+		uint8_t len		= _in[2];
+		uint8_t used	= 3;
+		bool	ok		= (start + len) <= sizeof(_reg);
+
+		if ((cmd == 0xC0) || (cmd == 0xC2)) {
+			if (ok && (_inLen < (3 + len))) {
+				return;
+			}
+			if (ok) {
+				SetRegisters(start, &_in[3], len);
+				used += len;
+				_auxUntil = now + ((cmd == 0xC0) ? 2000 : 500);
+			}
+		}
+		else if (cmd != 0xC1) {
+			ok = false;
+		}
+
+		if (ok) {
+			_out.push_back(0xC1);
+			_out.push_back(start);
+			_out.push_back(len);
+			for (uint8_t i = start; i < start + len; i++) {
+				_out.push_back((i < 6) ? _reg[i] : 0);
+			}
+			memmove(_in, &_in[used], _inLen - used);
+			_inLen -= used;
+		}
+		else {
+			_out.push_back(0xFF);
+			_out.push_back(0xFF);
+			_out.push_back(0xFF);
+			_inLen = 0;
+		}
+	}
+}
+
+bool EBYTESimModule::Accepts(const EBYTESimFrame &f) {
+
+	if ((f.from == this) || (_mode == 3) || ((_mode == 2) && !f.wor)) {
+		return false;
+	}
+	// can't hear while sending
+	if ((_txStart < f.end) && (_txEnd > f.start)) {
+		return false;
+	}
+	if ((f.channel != Channel()) || (f.key[0] != _reg[6]) || (f.key[1] != _reg[7])) {
+		return false;
+	}
+	return (f.to == 0xFFFF) || (f.to == Address()) || (Address() == 0xFFFF);
+}
+
+void EBYTESimModule::Deliver(const EBYTESimFrame &f, uint8_t rssi, uint64_t now) {
+
+	_out.insert(_out.end(), f.data, f.data + f.len);
+	if (_reg[5] & 0x80) {
+		_out.push_back(rssi);
+	}
+	_lastRSSI = rssi;
+	Received++;
+
+	// AUX goes low while the packet is going out of the UART
+	uint64_t until = now + ((uint64_t)(f.len + 1) * 10000000ULL) / UartBps();
+
+	if (until > _auxUntil) {
+		_auxUntil = until;
+	}
+}
+
+uint8_t EBYTESimModule::Register(uint8_t reg) {
+	return (reg < sizeof(_reg)) ? _reg[reg] : 0;
+}
+
+void EBYTESimModule::SetRegisters(uint8_t start, const uint8_t *data, uint8_t len) {
+	for (uint8_t i = 0; (i < len) && ((start + i) < sizeof(_reg)); i++) {
+		_reg[start + i] = data[i];
+	}
+}
+
+uint16_t EBYTESimModule::Address() {
+	return (_reg[0] << 8) | _reg[1];
+}
+
+uint8_t EBYTESimModule::Channel() {
+	return _reg[4];
+}
+
+uint8_t EBYTESimModule::Mode() {
+	return _mode;
+}
+
+bool EBYTESimModule::Fixed() {
+	return (_reg[5] & 0x40) != 0;
+}
+
+bool EBYTESimModule::LBT() {
+	return (_reg[5] & 0x10) != 0;
+}
+
+uint8_t EBYTESimModule::SubPacketBytes() {
+	static const uint8_t bytes[]{ 200, 128, 64, 32 };
+	return bytes[_reg[3] >> 6];
+}
+
+uint8_t EBYTESimModule::AirRate() {
+	return _reg[2] & 0b111;
+}
+
+uint8_t EBYTESimModule::Power() {
+	return _reg[3] & 0b11;
+}
+
+uint32_t EBYTESimModule::AirBps() {
+	static const uint32_t bps[]{ 2400, 2400, 2400, 4800, 9600, 19200, 38400, 62500 };
+	return bps[_reg[2] & 0b111];
+}
+
+uint32_t EBYTESimModule::UartBps() {
+	static const uint32_t bps[]{ 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+	return bps[_reg[2] >> 5];
+}
+
+/*
+airtime as EBYTE::AirTimeMicros() estimates it, so the library's pacing matches the simulation
+*/
+uint32_t EBYTESimModule::AirTimeMicros(uint16_t len) {
+
+	uint16_t packets = (len + SubPacketBytes() - 1) / SubPacketBytes();
+	uint32_t bits	 = ((uint32_t)len + (uint32_t)packets * EBYTE_SIM_OVERHEAD) * 8;
+
+	return (uint32_t)(((uint64_t)bits * 1000000UL) / AirBps());
+}
+
+uint32_t EBYTESimModule::WorMicros() {
+	return 500000UL * ((_reg[5] & 0b111) + 1);
+}
+
+void EBYTESimAir::Add(EBYTESimModule *module) {
+	module->SetMedium(this);
+	_modules.push_back(module);
+}
+
+void EBYTESimAir::Transmit(const EBYTESimFrame &frame) {
+	_onAir.push_back(frame);
+}
+
+bool EBYTESimAir::Busy(EBYTESimModule *at, uint8_t channel, uint64_t now) {
+
+	for (const EBYTESimFrame &f : _onAir) {
+		if ((f.from != at) && (f.channel == channel) && (f.start <= now) && (now < f.end)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void EBYTESimAir::Poll(uint64_t now) {
+
+	for (size_t i = 0; i < _onAir.size();) {
+
+		if (_onAir[i].end > now) {
+			i++;
+			continue;
+		}
+		for (EBYTESimModule *m : _modules) {
+			if (m->Accepts(_onAir[i])) {
+				m->Deliver(_onAir[i], RSSI, now);
+			}
+		}
+		_onAir.erase(_onAir.begin() + i);
+	}
+}
+
+static uint64_t HostMicros() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+EBYTESimHost::EBYTESimHost(EBYTESimMedium *medium) : _running(false) {
+	_medium = medium;
+}
+
+EBYTESimHost::~EBYTESimHost() {
+
+	Stop();
+	for (Port &p : _ports) {
+		close(p.fd);
+	}
+}
+
+int EBYTESimHost::Add(EBYTESimModule *module, EBYTEGpio *gpio, uint8_t m0, uint8_t m1, uint8_t aux) {
+
+	Port			p;
+	struct termios	tio;
+
+	if (_running) {
+		return -1;
+	}
+
+	p.fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if ((p.fd < 0) || (grantpt(p.fd) != 0) || (unlockpt(p.fd) != 0) || (ptsname_r(p.fd, p.path, sizeof(p.path)) != 0)) {
+		if (p.fd >= 0) {
+			close(p.fd);
+		}
+		return -1;
+	}
+
+	// raw from the start, so nothing written before the port is opened is echoed or mangled
+	if (tcgetattr(p.fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(p.fd, TCSANOW, &tio);
+	}
+
+	p.module	= module;
+	p.gpio		= gpio;
+	p.m0		= m0;
+	p.m1		= m1;
+	p.aux		= aux;
+	gpio->Write(aux, HIGH);
+
+	_ports.push_back(p);
+	return (int)_ports.size() - 1;
+}
+
+const char *EBYTESimHost::Path(uint8_t i) {
+	return (i < _ports.size()) ? _ports[i].path : nullptr;
+}
+
+void EBYTESimHost::Start() {
+
+	if (_running) {
+		return;
+	}
+	_running	= true;
+	_thread		= std::thread(&EBYTESimHost::Run, this);
+}
+
+void EBYTESimHost::Stop() {
+
+	if (!_running) {
+		return;
+	}
+	_running = false;
+	_thread.join();
+}
+
+/*
+the simulator thread: the modules only ever run here, so they need no locking. Pins are atomic
+*/
+void EBYTESimHost::Run() {
+
+	std::vector<struct pollfd>	fds(_ports.size());
+	uint8_t						buf[512];
+
+	for (size_t i = 0; i < _ports.size(); i++) {
+		fds[i].fd		= _ports[i].fd;
+		fds[i].events	= POLLIN;
+	}
+
+	while (_running) {
+
+		poll(fds.data(), fds.size(), 1);
+
+		uint64_t now = HostMicros();
+
+		for (Port &p : _ports) {
+
+			ssize_t n;
+
+			p.module->SetPins(p.gpio->Read(p.m0) == HIGH, p.gpio->Read(p.m1) == HIGH, now);
+
+			// EIO until the other end is opened, nothing to read then
+			while ((n = read(p.fd, buf, sizeof(buf))) > 0) {
+				p.module->Input(buf, n, now);
+			}
+			p.module->Poll(now);
+		}
+
+		_medium->Poll(now);
+
+		for (Port &p : _ports) {
+
+			size_t n = p.module->Output(buf, sizeof(buf));
+
+			if (n && (write(p.fd, buf, n) != (ssize_t)n)) {
+				fprintf(stderr, "sim: %s output overrun\n", p.path);
+			}
+			p.gpio->Write(p.aux, p.module->Aux(now) ? HIGH : LOW);
+		}
+	}
+}
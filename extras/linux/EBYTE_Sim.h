@@ -0,0 +1,206 @@
+#pragma once
+/*
+  Simulated E220 module
+
+  EBYTESimModule behaves as the module does on its UART and pins: program mode (M0 and M1 high)
+  answers the C0/C1/C2 register commands, normal and WOR transmit modes send what is written in sub
+  packets, WOR receive and normal mode receive, AUX is low while the module is busy. Received packets
+  are given to the MCU with the RSSI byte when REG3 asks for it, and the ambient RSSI command works
+  when REG1 enables it. Addresses, channels, fixed mode and the crypt key filter what is received.
+
+  The module knows nothing of time or the air itself: every call takes the time now (us), and sent
+  packets go to an EBYTESimMedium, which decides who hears them. EBYTESimAir is the simple one,
+  every packet reaches every module it is addressed to after its airtime, nothing is lost.
+  EBYTESimNetwork (EBYTE_SimNet.h) is the one with path loss and collisions; it runs modules on
+  virtual time and calls Poll() only at NextPoll().
+
+  EBYTESimHost runs modules on pseudo terminals in a thread of their own, so the real library (and
+  the gateway) can drive them through EBYTESerial and EBYTEGpioSim as if they were hardware.
+
+  Usage
+	EBYTEGpioSim	Pins;
+	EBYTESimAir		Air;
+	EBYTESimModule	A, B;
+	EBYTESimHost	Host(&Air);
+	SetGpio(&Pins);
+	Air.Add(&A);						Air.Add(&B);
+	Host.Add(&A, &Pins, 4, 5, 6);		Host.Add(&B, &Pins, 14, 15, 16);
+	Host.Start();
+	Port.Open(Host.Path(0));			EBYTE Transceiver(&Port, 4, 5, 6);
+*/
+
+#include "Arduino.h"
+#include "EBYTE_Linux.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define EBYTE_SIM_MODE_US		3000		// us AUX is low after a mode change
+#define EBYTE_SIM_BUFFER		400			// bytes the module takes from the UART
+#define EBYTE_SIM_OVERHEAD		8			// preamble and header bytes per sub packet, as EBYTE_AIR_OVERHEAD
+#define EBYTE_SIM_LBT_US		2000		// us LBT waits before listening again
+
+class EBYTESimModule;
+
+// one sub packet on air
+struct EBYTESimFrame {
+	EBYTESimModule	*from;
+	uint16_t		to;				// address, 0xFFFF for everyone
+	uint8_t			channel;
+	bool			wor;			// sent with a wake up preamble
+	uint8_t			key[2];			// crypt key it was sent with
+	uint8_t			rate;			// air data rate (REG0 bits 2-0) and power (REG1 bits 1-0) sent with
+	uint8_t			power;
+	uint64_t		queued;			// us the first byte of it was written to the module
+	uint64_t		start;			// us
+	uint64_t		end;			// us, airtime and preamble included
+	uint8_t			len;
+	uint8_t			data[200];
+};
+
+class EBYTESimMedium {
+
+public:
+
+	virtual ~EBYTESimMedium() {}
+
+	// method for a module to put a frame on air, from frame.start to frame.end
+	virtual void	Transmit(const EBYTESimFrame &frame) = 0;
+
+	// is the channel in use where the module is (LBT)
+	virtual bool	Busy(EBYTESimModule *, uint8_t, uint64_t)		{ return false; }
+
+	// ambient noise RSSI byte where the module is
+	virtual uint8_t	Noise(EBYTESimModule *, uint8_t, uint64_t)		{ return 0; }
+
+	// method to deliver frames whose airtime has ended
+	virtual void	Poll(uint64_t now) = 0;
+
+};
+
+class EBYTESimModule {
+
+public:
+
+	EBYTESimModule(EBYTESimMedium *medium = nullptr);
+
+	void		SetMedium(EBYTESimMedium *medium);
+
+	// MCU side: pins, bytes written to the module and bytes it has for the MCU
+	void		SetPins(bool m0, bool m1, uint64_t now);
+	void		Input(const uint8_t *data, size_t len, uint64_t now);
+	size_t		Output(uint8_t *data, size_t max);
+	size_t		OutputPending();
+	bool		Aux(uint64_t now);
+
+	// method to run the module: ends sub packets after a UART gap and starts sending them
+	void		Poll(uint64_t now);
+
+	// the next time Poll() has something to do, UINT64_MAX if nothing until more is written
+	uint64_t	NextPoll(uint64_t now);
+
+	// the earliest time a low AUX can go high, now if it is high
+	uint64_t	AuxHighAt(uint64_t now);
+
+	// air side, for the medium: would the module take the frame, and hand it over
+	bool		Accepts(const EBYTESimFrame &frame);
+	void		Deliver(const EBYTESimFrame &frame, uint8_t rssi, uint64_t now);
+
+	// the registers (ADDH, ADDL, REG0, REG1, CHAN, REG3, CRYPT_H, CRYPT_L) and what they mean
+	uint8_t		Register(uint8_t reg);
+	void		SetRegisters(uint8_t start, const uint8_t *data, uint8_t len);
+	uint16_t	Address();
+	uint8_t		Channel();
+	uint8_t		Mode();
+	bool		Fixed();
+	bool		LBT();
+	uint8_t		SubPacketBytes();
+	uint8_t		AirRate();
+	uint8_t		Power();
+	uint32_t	AirBps();
+	uint32_t	UartBps();
+	uint32_t	AirTimeMicros(uint16_t len);
+	uint32_t	WorMicros();
+
+	uint32_t	Sent		= 0;		// sub packets sent
+	uint32_t	Received	= 0;		// packets given to the MCU
+	uint32_t	Overflows	= 0;		// bytes lost to a full buffer
+	uint32_t	Deferred	= 0;		// sub packets held back by LBT
+
+private:
+
+	void		Command(uint64_t now);
+	void		Send(uint64_t now);
+
+	EBYTESimMedium			*_medium;
+	uint8_t					_reg[8];
+	uint8_t					_mode		= 0;
+	uint8_t					_in[EBYTE_SIM_BUFFER];
+	uint16_t				_inLen		= 0;
+	uint64_t				_lastIn		= 0;
+	uint64_t				_firstIn	= 0;		// first byte of what is buffered
+	uint64_t				_lbtUntil	= 0;		// LBT found the channel busy, listen again then
+	uint64_t				_auxUntil	= 0;		// AUX low until, mode changes and output
+	uint64_t				_txStart	= 0;		// sending from
+	uint64_t				_txEnd		= 0;		// sending until
+	uint8_t					_lastRSSI	= 0;
+	std::vector<uint8_t>	_out;
+
+};
+
+// every frame reaches every module that accepts it, no loss or collisions
+class EBYTESimAir : public EBYTESimMedium {
+
+public:
+
+	void	Add(EBYTESimModule *module);
+	void	Transmit(const EBYTESimFrame &frame);
+	bool	Busy(EBYTESimModule *at, uint8_t channel, uint64_t now);
+	void	Poll(uint64_t now);
+
+	// the RSSI byte every frame arrives with
+	uint8_t	RSSI	= 200;
+
+private:
+
+	std::vector<EBYTESimModule *>	_modules;
+	std::vector<EBYTESimFrame>		_onAir;
+
+};
+
+class EBYTESimHost {
+
+public:
+
+	EBYTESimHost(EBYTESimMedium *medium);
+	~EBYTESimHost();
+
+	// method to put a module on a new pseudo terminal, its pins read and written through gpio
+	// returns the index for Path(), -1 if no pseudo terminal could be had
+	int			Add(EBYTESimModule *module, EBYTEGpio *gpio, uint8_t m0, uint8_t m1, uint8_t aux);
+
+	// the device to open with EBYTESerial
+	const char	*Path(uint8_t i);
+
+	void		Start();
+	void		Stop();
+
+private:
+
+	struct Port {
+		EBYTESimModule	*module;
+		EBYTEGpio		*gpio;
+		uint8_t			m0, m1, aux;
+		int				fd;
+		char			path[64];
+	};
+
+	void		Run();
+
+	EBYTESimMedium		*_medium;
+	std::vector<Port>	_ports;
+	std::thread			_thread;
+	std::atomic<bool>	_running;
+
+};
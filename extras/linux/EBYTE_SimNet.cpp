@@ -0,0 +1,576 @@
+/*
+  Simulated radio network, see EBYTE_SimNet.h
+*/
+
+#include "EBYTE_SimNet.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+// dBm out of the antenna by REG1 power bits, and the weakest packet heard at each air rate
+static const float	txDbm[4]			= { 22, 17, 13, 10 };
+static const float	sensitivityDbm[8]	= { -129, -129, -129, -126, -123, -120, -117, -114 };
+
+// the node a coroutine starts for
+static EBYTESimNode	*entering	= nullptr;
+
+static double Milliwatts(float dBm) {
+	return pow(10.0, dBm / 10.0);
+}
+
+// ADR 0 to 2 are all 2.4k
+static uint8_t RateClass(uint8_t rate) {
+	return (rate < 2) ? 2 : rate;
+}
+
+// splitmix64, the same shadowing for a pair of nodes in every run with the same seed
+static uint64_t Mix(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/*
+a normally distributed number (mean 0, deviation 1) for the pair a, b, Box-Muller
+*/
+static double Gaussian(uint32_t seed, uint16_t a, uint16_t b) {
+
+	uint64_t	h	= Mix(((uint64_t)seed << 32) | ((uint32_t)a << 16) | b);
+	double		u1	= ((h >> 11) + 1.0) / 9007199254740993.0;
+	double		u2	= (Mix(h) >> 11) / 9007199254740992.0;
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+EBYTESimNode::EBYTESimNode(EBYTESimNetwork *net, uint16_t index, float x, float y, ebyteSimFunc setup, ebyteSimFunc loop, void *data) :
+	Module(net), Radio(&Port, EBYTE_NET_M0, EBYTE_NET_M1, EBYTE_NET_AUX), _stack(EBYTE_NET_STACK) {
+
+	Index		= index;
+	X			= x;
+	Y			= y;
+	Data		= data;
+	Port._node	= this;
+	_net		= net;
+	_setup		= setup;
+	_loop		= loop;
+}
+
+/*
+the coroutine: setup once, then loop for ever. Never returns, the network just stops resuming it
+*/
+void EBYTESimNode::Entry() {
+
+	EBYTESimNode *node = entering;
+
+	if (node->_setup) {
+		node->_setup(node);
+	}
+	for (;;) {
+
+		uint32_t sleeps = node->_sleeps;
+
+		if (!node->_loop) {
+			node->_net->Suspend(UINT64_MAX, false);
+			continue;
+		}
+		node->_loop(node);
+		if (sleeps == node->_sleeps) {
+			node->_net->Sleep(node->_net->LoopMicros);
+		}
+	}
+}
+
+void EBYTESimNode::Wait(unsigned long ms) {
+
+	_net->Touch(this);
+	_auxSpins	= 0;
+	_readSpins	= 0;
+	_sleeps++;
+
+	if (Module.OutputPending() || (Port._peeked >= 0)) {
+		return;
+	}
+	_net->Suspend(_net->_now + (uint64_t)ms * 1000, true);
+}
+
+int EBYTESimPort::available() {
+
+	EBYTESimNetwork *net = _node->_net;
+
+	net->Touch(_node);
+	if (net->Empty(_node)) {
+		return 0;
+	}
+	return (int)_node->Module.OutputPending() + ((_peeked >= 0) ? 1 : 0);
+}
+
+int EBYTESimPort::read() {
+
+	uint8_t c;
+	int		p = _peeked;
+
+	_node->_net->Touch(_node);
+	if (p >= 0) {
+		_peeked = -1;
+		return p;
+	}
+	if (_node->_net->Empty(_node)) {
+		return -1;
+	}
+	_node->Module.Output(&c, 1);
+	return c;
+}
+
+int EBYTESimPort::peek() {
+
+	uint8_t c;
+
+	_node->_net->Touch(_node);
+	if ((_peeked < 0) && !_node->_net->Empty(_node)) {
+		_node->Module.Output(&c, 1);
+		_peeked = c;
+	}
+	return _peeked;
+}
+
+size_t EBYTESimPort::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t EBYTESimPort::write(const uint8_t *buffer, size_t size) {
+
+	EBYTESimNetwork *net = _node->_net;
+
+	net->Touch(_node);
+	_node->Module.Input(buffer, size, net->_now);
+	_node->_auxSpins	= 0;
+	_node->_readSpins	= 0;
+	net->Update(_node);
+	return size;
+}
+
+/*
+readBytes() waiting: asleep until the module has bytes, or ms has passed
+*/
+void EBYTESimPort::waitAvailable(unsigned long ms) {
+
+	EBYTESimNetwork *net = _node->_net;
+
+	net->Touch(_node);
+	if (_node->Module.OutputPending() || (_peeked >= 0)) {
+		return;
+	}
+	_node->_sleeps++;
+	net->Suspend(net->_now + (uint64_t)ms * 1000, true);
+}
+
+EBYTESimNetwork::EBYTESimNetwork() {
+	memset(_busy, 0, sizeof(_busy));
+	memset(_busyUntil, 0, sizeof(_busyUntil));
+}
+
+EBYTESimNetwork::~EBYTESimNetwork() {
+	for (EBYTESimNode *node : _nodes) {
+		delete node;
+	}
+}
+
+EBYTESimNode *EBYTESimNetwork::Add(float x, float y, ebyteSimFunc setup, ebyteSimFunc loop, void *data) {
+
+	EBYTESimNode *node = new EBYTESimNode(this, (uint16_t)_nodes.size(), x, y, setup, loop, data);
+
+	_nodes.push_back(node);
+	_index[&node->Module] = node->Index;
+	return node;
+}
+
+EBYTESimNode *EBYTESimNetwork::Node(uint16_t i) {
+	return (i < _nodes.size()) ? _nodes[i] : nullptr;
+}
+
+uint16_t EBYTESimNetwork::Nodes() {
+	return (uint16_t)_nodes.size();
+}
+
+uint64_t EBYTESimNetwork::Now() {
+	return _now;
+}
+
+/*
+method to run the events due within us, one at a time in time order, those at the same time in the
+order they were scheduled
+*/
+void EBYTESimNetwork::Run(uint64_t us) {
+
+	uint64_t	end		= _now + us;
+	EBYTEClock	*clock	= GetClock();
+	EBYTEGpio	*gpio	= GetGpio();
+
+	SetClock(this);
+	SetGpio(this);
+	Links();
+
+	for (EBYTESimNode *node : _nodes) {
+		if (!node->_started) {
+			getcontext(&node->_context);
+			node->_context.uc_stack.ss_sp	= node->_stack.data();
+			node->_context.uc_stack.ss_size	= node->_stack.size();
+			node->_context.uc_link			= nullptr;
+			makecontext(&node->_context, EBYTESimNode::Entry, 0);
+			node->_started	= true;
+			node->_wake		= Schedule(_now, EVENT_WAKE, node->Index);
+		}
+	}
+
+	while (!_events.empty() && (_events.top().at <= end)) {
+
+		Event e = _events.top();
+
+		_events.pop();
+		_now = e.at;
+		Events++;
+
+		switch (e.type) {
+
+		case EVENT_WAKE:
+			if (e.seq == _nodes[e.id]->_wake) {
+				Resume(_nodes[e.id]);
+			}
+			break;
+
+		case EVENT_MODULE:
+			if (e.seq == _nodes[e.id]->_poll) {
+				_nodes[e.id]->_pollAt = UINT64_MAX;
+				Update(_nodes[e.id]);
+			}
+			break;
+
+		case EVENT_FRAME:
+			End(e.id);
+			break;
+		}
+	}
+	_now = end;
+
+	SetClock(clock);
+	SetGpio(gpio);
+}
+
+uint32_t EBYTESimNetwork::Schedule(uint64_t at, uint8_t type, uint32_t id) {
+
+	Event e = { at, ++_seq, type, id };
+
+	_events.push(e);
+	return e.seq;
+}
+
+/*
+method for the node running to give way until until, or until its module has bytes for it
+*/
+void EBYTESimNetwork::Suspend(uint64_t until, bool onData) {
+
+	EBYTESimNode *node = _current;
+
+	node->_lag		= 0;
+	node->_waiting	= onData;
+	node->_wake		= Schedule(until, EVENT_WAKE, node->Index);
+	swapcontext(&node->_context, &_main);
+	node->_waiting	= false;
+}
+
+void EBYTESimNetwork::Resume(EBYTESimNode *node) {
+
+	_current	= node;
+	entering	= node;
+	swapcontext(&_main, &node->_context);
+	_current	= nullptr;
+}
+
+/*
+method for a node about to use its module: the time it ran ahead reading the clock is used up first,
+then the module is brought up to now
+*/
+void EBYTESimNetwork::Touch(EBYTESimNode *node) {
+
+	if (node->_lag) {
+		Suspend(_now + node->_lag, false);
+	}
+	Update(node);
+}
+
+/*
+method to run the module if it is due, and schedule it for the next time it will be
+*/
+void EBYTESimNetwork::Update(EBYTESimNode *node) {
+
+	uint64_t at;
+
+	if (node->Module.NextPoll(_now) <= _now) {
+		node->Module.Poll(_now);
+	}
+	at = node->Module.NextPoll(_now);
+	if (at == node->_pollAt) {
+		return;
+	}
+	node->_pollAt = at;
+	node->_poll   = 0;
+	if (at != UINT64_MAX) {
+		// nothing is polled twice at the same time
+		node->_pollAt	= std::max(at, _now + 1);
+		node->_poll		= Schedule(node->_pollAt, EVENT_MODULE, node->Index);
+	}
+}
+
+/*
+true if the module has nothing for the node. Finding nothing twice in a row is a wait loop, and the
+node sleeps until bytes come or PollMicros has passed
+*/
+bool EBYTESimNetwork::Empty(EBYTESimNode *node) {
+
+	if (node->Module.OutputPending() || (node->Port._peeked >= 0)) {
+		node->_readSpins = 0;
+		return false;
+	}
+	if (++node->_readSpins < 2) {
+		return true;
+	}
+	node->_readSpins = 0;
+	node->_sleeps++;
+	Suspend(_now + PollMicros, true);
+	Update(node);
+	return (node->Module.OutputPending() == 0) && (node->Port._peeked < 0);
+}
+
+uint64_t EBYTESimNetwork::Micros() {
+
+	EBYTESimNode *node = _current;
+
+	if (!node) {
+		return _now;
+	}
+	node->_lag += Tick;
+	if (node->_lag >= EBYTE_NET_LAG_US) {
+		Suspend(_now + node->_lag, false);
+	}
+	return _now + node->_lag;
+}
+
+void EBYTESimNetwork::Sleep(uint64_t us) {
+
+	EBYTESimNode *node = _current;
+
+	if (!node) {
+		return;
+	}
+	node->_auxSpins		= 0;
+	node->_readSpins	= 0;
+	node->_sleeps++;
+	Suspend(_now + node->_lag + us, false);
+}
+
+void EBYTESimNetwork::Mode(uint8_t, uint8_t) {
+}
+
+void EBYTESimNetwork::Write(uint8_t pin, uint8_t val) {
+
+	EBYTESimNode *node = _current;
+
+	if (!node || ((pin != EBYTE_NET_M0) && (pin != EBYTE_NET_M1))) {
+		return;
+	}
+	Touch(node);
+	if (pin == EBYTE_NET_M0) {
+		node->_m0 = (val == HIGH);
+	}
+	else {
+		node->_m1 = (val == HIGH);
+	}
+	node->Module.SetPins(node->_m0, node->_m1, _now);
+	node->_auxSpins = 0;
+	Update(node);
+}
+
+/*
+AUX read low a second time in a row is a wait loop: the node sleeps until AUX can go high, no more
+than 10 ms at a time in case that changes
+*/
+int EBYTESimNetwork::Read(uint8_t pin) {
+
+	EBYTESimNode *node = _current;
+
+	if (!node) {
+		return HIGH;
+	}
+	if (pin == EBYTE_NET_M0) {
+		return node->_m0 ? HIGH : LOW;
+	}
+	if (pin == EBYTE_NET_M1) {
+		return node->_m1 ? HIGH : LOW;
+	}
+	if (pin != EBYTE_NET_AUX) {
+		return HIGH;
+	}
+
+	Touch(node);
+	if (node->Module.Aux(_now)) {
+		node->_auxSpins = 0;
+		return HIGH;
+	}
+	if (++node->_auxSpins < 2) {
+		return LOW;
+	}
+	node->_auxSpins = 0;
+	node->_sleeps++;
+	Suspend(std::min(node->Module.AuxHighAt(_now), _now + 10000), false);
+	Update(node);
+	return node->Module.Aux(_now) ? HIGH : LOW;
+}
+
+/*
+method to put a frame on air, its end is delivered as an event. Frames long over are forgotten
+*/
+void EBYTESimNetwork::Transmit(const EBYTESimFrame &frame) {
+
+	Frame		f		= { frame, _index[frame.from] };
+	uint64_t	from	= std::max(frame.start, _busyUntil[frame.channel]);
+
+	while (!_frames.empty() && ((_frames.front().frame.end + EBYTE_NET_KEEP_US) < _now)) {
+		_frames.pop_front();
+		_firstFrame++;
+	}
+
+	if (frame.end > from) {
+		_busy[frame.channel] += frame.end - from;
+	}
+	_busyUntil[frame.channel] = std::max(_busyUntil[frame.channel], frame.end);
+
+	Schedule(frame.end, EVENT_FRAME, _firstFrame + (uint32_t)_frames.size());
+	_frames.push_back(f);
+	Sent++;
+}
+
+/*
+mW on a channel at a node from everything on air some time from from to to, except one frame and
+what the node sends itself
+*/
+float EBYTESimNetwork::OnAir(uint16_t at, uint8_t channel, uint64_t from, uint64_t to, const Frame *except) {
+
+	double mw = 0;
+
+	for (const Frame &f : _frames) {
+		if ((&f != except) && (f.from != at) && (f.frame.channel == channel) && (f.frame.start < to) && (f.frame.end > from)) {
+			mw += Milliwatts(Power(f, at));
+		}
+	}
+	return (float)mw;
+}
+
+/*
+method to hand a frame whose airtime has ended to every module that takes it and can make it out
+*/
+void EBYTESimNetwork::End(uint32_t id) {
+
+	const Frame	&f		= _frames[id - _firstFrame];
+	uint8_t		rate	= RateClass(f.frame.rate);
+
+	for (EBYTESimNode *node : _nodes) {
+
+		if ((node->Index == f.from) || !node->Module.Accepts(f.frame) || (RateClass(node->Module.AirRate()) != rate)) {
+			continue;
+		}
+
+		float dBm			= Power(f, node->Index);
+		float interference	= OnAir(node->Index, f.frame.channel, f.frame.start, f.frame.end, &f);
+
+		if (dBm < sensitivityDbm[rate]) {
+			Weak++;
+			continue;
+		}
+		if ((interference > 0) && ((dBm - 10.0 * log10(interference)) < CaptureDb)) {
+			Collided++;
+			continue;
+		}
+
+		node->Module.Deliver(f.frame, (uint8_t)std::min(255.0f, std::max(0.0f, 256.0f + roundf(dBm))), _now);
+		Delivered++;
+		_latency.push_back((uint32_t)(_now - f.frame.queued));
+
+		if (node->_waiting) {
+			node->_waiting	= false;
+			node->_wake		= Schedule(_now, EVENT_WAKE, node->Index);
+		}
+	}
+}
+
+float EBYTESimNetwork::Power(const Frame &f, uint16_t to) {
+	return txDbm[f.frame.power & 3] - _loss[(size_t)f.from * _nodes.size() + to];
+}
+
+float EBYTESimNetwork::ReceivedDbm(uint16_t from, uint16_t to, uint8_t power) {
+
+	Links();
+	if ((from >= _nodes.size()) || (to >= _nodes.size())) {
+		return -1000;
+	}
+	return txDbm[power & 3] - _loss[(size_t)from * _nodes.size() + to];
+}
+
+bool EBYTESimNetwork::Busy(EBYTESimModule *at, uint8_t channel, uint64_t now) {
+	return OnAir(_index[at], channel, now, now + 1, nullptr) >= Milliwatts(LbtDbm);
+}
+
+uint8_t EBYTESimNetwork::Noise(EBYTESimModule *at, uint8_t channel, uint64_t now) {
+
+	float dBm = 10.0 * log10(OnAir(_index[at], channel, now, now + 1, nullptr) + Milliwatts(NoiseDbm));
+
+	return (uint8_t)std::min(255.0f, std::max(0.0f, 256.0f + roundf(dBm)));
+}
+
+void EBYTESimNetwork::Poll(uint64_t) {
+	// frames are delivered by their end events
+}
+
+/*
+method to work out the path loss between every pair of nodes, once for all nodes added
+*/
+void EBYTESimNetwork::Links() {
+
+	size_t n = _nodes.size();
+
+	if (_loss.size() == n * n) {
+		return;
+	}
+	_loss.assign(n * n, 0);
+
+	for (size_t a = 0; a < n; a++) {
+		for (size_t b = a + 1; b < n; b++) {
+
+			float dx	= _nodes[a]->X - _nodes[b]->X;
+			float dy	= _nodes[a]->Y - _nodes[b]->Y;
+			float d		= std::max(1.0f, sqrtf(dx * dx + dy * dy));
+			float loss	= PathLoss1m + 10.0 * PathLossExponent * log10(d) + ShadowingDb * Gaussian(Seed, a, b);
+
+			_loss[a * n + b] = loss;
+			_loss[b * n + a] = loss;
+		}
+	}
+}
+
+float EBYTESimNetwork::Occupancy(uint8_t channel) {
+	return _now ? std::min(1.0f, (float)_busy[channel] / (float)_now) : 0;
+}
+
+uint32_t EBYTESimNetwork::Latency(float percentile) {
+
+	std::vector<uint32_t>	v(_latency);
+	size_t					i;
+
+	if (v.empty()) {
+		return 0;
+	}
+	i = std::min(v.size() - 1, (size_t)(percentile / 100.0 * v.size()));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
@@ -0,0 +1,245 @@
+#pragma once
+/*
+  Simulated radio network: hundreds of EBYTE nodes on virtual time
+
+  Each node is an EBYTE instance on a simulated module (EBYTESimModule), running a setup() and loop()
+  of its own as a coroutine, as it would on its own MCU. EBYTESimNetwork is the clock, the pins and
+  the air for all of them: one thread, discrete events, no pseudo terminals, so hours of traffic
+  take seconds and every run with the same seed is the same.
+
+  Time only moves while a node waits: delay(), Wait(), AUX or the port read again and again in a
+  wait loop, and Tick us every time the clock is read. A node that reads AUX low again without
+  doing anything else in between sleeps until AUX can next go high; one finding nothing to read
+  twice in a row sleeps until the module has bytes or PollMicros has passed. A loop() that never
+  waits costs LoopMicros a pass; end loop() with Wait() instead, as a node sleeping until its next
+  job or a packet comes in.
+
+  The air:
+	path loss		PathLoss1m + 10 * PathLossExponent * log10(d), plus ShadowingDb of log normal
+					shadowing fixed per pair of nodes (Seed)
+	power			22, 17, 13, 10 dBm by REG1 (E220-900T22D)
+	sensitivity		-129 dBm at 2.4k air rate, 3 dB worse each time the rate doubles
+	reception		same channel, air rate, key and address as the module filters them, strong
+					enough, and CaptureDb above everything else on the channel during the packet,
+					all of it summed. Anything less counts as a collision (or too weak)
+	RSSI			received power as the module's RSSI byte (256 + dBm), the ambient RSSI the sum
+					of what is on the channel and NoiseDbm
+	LBT				channel busy when what is on it where the module is sums above LbtDbm
+	WOR				the preamble (WOR cycle) is airtime in front of the packet, as the module does it
+  Airtime is the module's own (ADR, sub packet size, EBYTE_SIM_OVERHEAD), UART transfers take no time.
+
+  Usage
+	EBYTESimNetwork Net;
+	Net.Add(0, 0, GatewaySetup, GatewayLoop);
+	for (...) Net.Add(x, y, SensorSetup, SensorLoop, &SensorState[i]);
+	Net.Run(3600000000ULL);					// an hour
+	Net.Delivered, Net.Collided, Net.Latency(99), Net.Occupancy(channel)
+
+  A node program gets its node: node->Radio is its EBYTE (pins EBYTE_NET_M0, _M1, _AUX), node->Data
+  what was given to Add(). Nodes run one at a time, Serial and printf from them are safe; a node's port
+and Wait() are for its own program only.
+*/
+
+#include "Arduino.h"
+#include "EBYTE_Linux.h"
+#include "EBYTE_Sim.h"
+#include "EBYTE_E220.h"
+
+#include <ucontext.h>
+
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#define EBYTE_NET_M0			0
+#define EBYTE_NET_M1			1
+#define EBYTE_NET_AUX			2
+#define EBYTE_NET_STACK			65536		// bytes of stack per node
+#define EBYTE_NET_LAG_US		100			// us of clock reads a node runs ahead before it gives way
+#define EBYTE_NET_KEEP_US		10000000	// us a frame is kept after it ends, longer than any frame lasts
+
+class EBYTESimNetwork;
+class EBYTESimNode;
+
+typedef void (*ebyteSimFunc) (EBYTESimNode *node);
+
+// the node's UART, straight into its module
+class EBYTESimPort : public Stream {
+
+public:
+
+	int		available();
+	int		read();
+	int		peek();
+	size_t	write(uint8_t c);
+	size_t	write(const uint8_t *buffer, size_t size);
+	using	Print::write;
+
+protected:
+
+	void	waitAvailable(unsigned long ms);
+
+private:
+
+	friend class EBYTESimNetwork;
+	friend class EBYTESimNode;
+
+	EBYTESimNode	*_node	= nullptr;
+	int				_peeked	= -1;
+
+};
+
+class EBYTESimNode {
+
+public:
+
+	// method for node programs: sleep up to ms, waking as soon as the module has something to read
+	void			Wait(unsigned long ms);
+
+	uint16_t		Index;
+	float			X;				// m
+	float			Y;
+	void			*Data;
+
+	EBYTESimModule	Module;
+	EBYTESimPort	Port;
+	EBYTE			Radio;
+
+private:
+
+	friend class EBYTESimNetwork;
+	friend class EBYTESimPort;
+
+	EBYTESimNode(EBYTESimNetwork *net, uint16_t index, float x, float y, ebyteSimFunc setup, ebyteSimFunc loop, void *data);
+
+	static void			Entry();
+
+	EBYTESimNetwork		*_net;
+	ebyteSimFunc		_setup;
+	ebyteSimFunc		_loop;
+	ucontext_t			_context;
+	std::vector<char>	_stack;
+	bool				_started	= false;
+	bool				_waiting	= false;		// woken by bytes for the MCU
+	bool				_m0			= false;
+	bool				_m1			= false;
+	uint32_t			_wake		= 0;			// sequence of the wake up event that counts
+	uint32_t			_poll		= 0;			// and of the module poll event
+	uint64_t			_pollAt		= UINT64_MAX;
+	uint64_t			_lag		= 0;			// us run ahead of the network by reading the clock
+	uint8_t				_auxSpins	= 0;			// AUX read low in a row
+	uint8_t				_readSpins	= 0;			// reads finding nothing in a row
+	uint32_t			_sleeps		= 0;			// waits, to tell a loop() that never waits
+
+};
+
+class EBYTESimNetwork : public EBYTESimMedium, public EBYTEClock, public EBYTEGpio {
+
+public:
+
+	EBYTESimNetwork();
+	~EBYTESimNetwork();
+
+	// method to add a node at x, y (m) running setup once, then loop for ever
+	EBYTESimNode	*Add(float x, float y, ebyteSimFunc setup, ebyteSimFunc loop, void *data = nullptr);
+	EBYTESimNode	*Node(uint16_t i);
+	uint16_t		Nodes();
+
+	// method to run every node for us of virtual time, again to go on. The clock and pins are the
+	// network's while it runs
+	void			Run(uint64_t us);
+	uint64_t		Now();
+
+	// received power (dBm) of a packet from one node at another
+	float			ReceivedDbm(uint16_t from, uint16_t to, uint8_t power);
+
+	// airtime on a channel so far, overlaps counted once, as a share of the time run
+	float			Occupancy(uint8_t channel);
+
+	// us from the first byte written to the sending module to the end of the packet, of those
+	// delivered: Latency(50) the median, Latency(99) the 99th percentile
+	uint32_t		Latency(float percentile);
+
+	float			PathLoss1m			= 40.0;
+	float			PathLossExponent	= 2.7;
+	float			ShadowingDb			= 4.0;
+	float			NoiseDbm			= -120.0;
+	float			CaptureDb			= 6.0;
+	float			LbtDbm				= -90.0;
+	uint32_t		Seed				= 1;
+	uint32_t		Tick				= 1;		// us the clock moves on every reading
+	uint32_t		LoopMicros			= 1000;		// us a loop() pass that doesn't wait takes
+	uint32_t		PollMicros			= 1000;		// us a node polling an empty port sleeps
+
+	// counted per module a packet was for: delivered, lost to other packets, too weak to hear. A module
+	// sending at the time doesn't hear it at all, and isn't counted
+	uint32_t		Sent				= 0;		// sub packets put on air
+	uint32_t		Delivered			= 0;
+	uint32_t		Collided			= 0;
+	uint32_t		Weak				= 0;
+	uint32_t		Events				= 0;
+
+	// EBYTESimMedium
+	void			Transmit(const EBYTESimFrame &frame);
+	bool			Busy(EBYTESimModule *at, uint8_t channel, uint64_t now);
+	uint8_t			Noise(EBYTESimModule *at, uint8_t channel, uint64_t now);
+	void			Poll(uint64_t now);
+
+	// EBYTEClock and EBYTEGpio, for the node running
+	uint64_t		Micros();
+	void			Sleep(uint64_t us);
+	void			Mode(uint8_t pin, uint8_t mode);
+	void			Write(uint8_t pin, uint8_t val);
+	int				Read(uint8_t pin);
+
+private:
+
+	friend class EBYTESimNode;
+	friend class EBYTESimPort;
+
+	enum EVENT_TYPE {
+		EVENT_WAKE		= 0,		// a node's coroutine goes on
+		EVENT_MODULE	= 1,		// a module's Poll()
+		EVENT_FRAME		= 2			// a frame's airtime ends
+	};
+
+	struct Event {
+		uint64_t	at;
+		uint32_t	seq;
+		uint8_t		type;
+		uint32_t	id;				// node, or frame
+		bool operator>(const Event &e) const { return (at != e.at) ? (at > e.at) : (seq > e.seq); }
+	};
+
+	struct Frame {
+		EBYTESimFrame	frame;
+		uint16_t		from;
+	};
+
+	uint32_t		Schedule(uint64_t at, uint8_t type, uint32_t id);
+	void			Suspend(uint64_t until, bool onData);
+	void			Resume(EBYTESimNode *node);
+	void			Touch(EBYTESimNode *node);
+	void			Update(EBYTESimNode *node);
+	bool			Empty(EBYTESimNode *node);
+	void			End(uint32_t id);
+	float			Power(const Frame &f, uint16_t to);
+	float			OnAir(uint16_t at, uint8_t channel, uint64_t from, uint64_t to, const Frame *except);
+	void			Links();
+
+	std::vector<EBYTESimNode *>	_nodes;
+	std::unordered_map<EBYTESimModule *, uint16_t>	_index;
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>>	_events;
+	std::deque<Frame>			_frames;				// on air, and ended within EBYTE_NET_KEEP_US
+	uint32_t					_firstFrame	= 0;		// id of _frames.front()
+	std::vector<float>			_loss;					// dB, from * nodes + to
+	std::vector<uint32_t>		_latency;
+	uint64_t					_busy[256];				// us of airtime per channel
+	uint64_t					_busyUntil[256];
+	uint64_t					_now		= 0;
+	uint32_t					_seq		= 0;
+	EBYTESimNode				*_current	= nullptr;
+	ucontext_t					_main;
+
+};
@@ -0,0 +1,3 @@
+#pragma once
+// Arduino puts Stream in its own header, the library includes it by name
+#include "Arduino.h"
@@ -0,0 +1,108 @@
+/*
+  ebyte-cat: talk to ebyte-gatewayd from a terminal or a script
+
+  Every frame the gateway receives is printed as "<module> <hex bytes>  |<printable>|". Each line
+  read from stdin as "<module> <text>" is sent as text through that module, "<module> x<hex>" as
+  bytes (fixed mode: x0002170102... for address 0x0002 channel 0x17).
+
+  usage: ebyte-cat [socket]
+*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static void Print(const unsigned char *msg, ssize_t len) {
+
+	printf("%u ", msg[0]);
+	for (ssize_t i = 1; i < len; i++) {
+		printf("%02X", msg[i]);
+	}
+	printf("  |");
+	for (ssize_t i = 1; i < len; i++) {
+		putchar(isprint(msg[i]) ? msg[i] : '.');
+	}
+	printf("|\n");
+	fflush(stdout);
+}
+
+static ssize_t Parse(const char *line, unsigned char *msg, size_t max) {
+
+	char			*text;
+	unsigned long	module = strtoul(line, &text, 10);
+	size_t			len = 1;
+
+	if ((text == line) || (module > 255) || (*text != ' ')) {
+		return -1;
+	}
+	text++;
+	msg[0] = (unsigned char)module;
+
+	if (*text == 'x') {
+		for (text++; isxdigit(text[0]) && isxdigit(text[1]) && (len < max); text += 2) {
+			char hex[3] = { text[0], text[1], 0 };
+			msg[len++] = (unsigned char)strtoul(hex, nullptr, 16);
+		}
+	}
+	else {
+		while (*text && (*text != '\n') && (len < max)) {
+			msg[len++] = (unsigned char)*text++;
+		}
+	}
+	return (len > 1) ? (ssize_t)len : -1;
+}
+
+int main(int argc, char **argv) {
+
+	const char			*path	= (argc > 1) ? argv[1] : "/tmp/ebyte.sock";
+	struct sockaddr_un	addr;
+	int					fd		= socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	bool				input	= true;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	if ((fd < 0) || (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	for (;;) {
+
+		struct pollfd	p[2]	= { { fd, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+		unsigned char	msg[257];
+		char			line[600];
+
+		if (poll(p, input ? 2 : 1, -1) < 0) {
+			return 1;
+		}
+		if (p[0].revents) {
+			ssize_t n = recv(fd, msg, sizeof(msg), 0);
+			if (n <= 0) {
+				return 0;
+			}
+			Print(msg, n);
+		}
+		if (input && p[1].revents) {
+			if (!fgets(line, sizeof(line), stdin)) {
+				// keep printing what comes in after stdin ends
+				input = false;
+				continue;
+			}
+			ssize_t n = Parse(line, msg, sizeof(msg));
+			if (n < 0) {
+				fprintf(stderr, "expected: <module> <text> or <module> x<hex>\n");
+			}
+			else if (send(fd, msg, n, 0) != n) {
+				fprintf(stderr, "send: %s\n", strerror(errno));
+			}
+		}
+	}
+}
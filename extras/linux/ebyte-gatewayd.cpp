@@ -0,0 +1,473 @@
+/*
+  ebyte-gatewayd: several E220 modules, one epoll loop, frames exchanged over a UNIX socket
+
+  Each module is set up with the library (init() reads its registers through program mode), then its
+  port is read and written directly, non-blocking, from one epoll loop. The module gives no framing
+  on its UART, a packet ends when the port has been quiet for the gap time.
+
+  The socket is SOCK_SEQPACKET, one message per frame: [module index][bytes as the module gave them,
+  RSSI byte included if enabled]. Clients send the same way, [module index][bytes to write], fixed
+  mode frames starting with their address and channel. A client that doesn't keep up loses frames.
+  Client frames longer than GW_MAX_FRAME are rejected, not cut; so are frames for a module gone.
+  A module that hangs up (adapter unplugged) is logged and taken out of the loop, its queue dropped.
+
+  Writes to a module are paced: the next frame waits for AUX (when there is one) and for the UART and
+  airtime of the frame before it, so the module's buffer never overflows.
+
+  usage: ebyte-gatewayd [-s socket] [-g gpiochip] [-b baud] [-t gap ms] [-n simulated] port[:m0,m1,aux] ...
+
+	ebyte-gatewayd -s /run/ebyte.sock /dev/ttyUSB0:17,27,22 /dev/ttyUSB1:5,6,13
+	ebyte-gatewayd -s /tmp/ebyte.sock -n 2			two simulated modules on pseudo terminals
+
+  Pins are line offsets on the gpiochip; without them the library falls back to fixed delays.
+*/
+
+#include "EBYTE_E220.h"
+#include "EBYTE_Linux.h"
+#include "EBYTE_Sim.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GW_MAX_FRAME		256
+#define GW_EVENTS			32
+#define GW_SIM_MAX			(EBYTE_GPIO_LINES / 3)
+
+struct Module {
+	std::string						path;
+	EBYTESerial						port;
+	std::unique_ptr<EBYTE>			radio;
+	uint8_t							rx[GW_MAX_FRAME];
+	uint16_t						rxLen		= 0;
+	unsigned long					rxLast		= 0;
+	std::deque<std::vector<uint8_t>>	tx;
+	size_t							txDone		= 0;		// bytes of tx.front() written
+	unsigned long					txNext		= 0;		// micros() the next frame may go
+	bool							txWaiting	= false;	// EPOLLOUT wanted
+	uint32_t						framesIn	= 0;
+	uint32_t						framesOut	= 0;
+	uint32_t						overflows	= 0;		// frames published early, the buffer full
+	bool							gone		= false;	// unplugged, or the other end closed
+};
+
+static std::vector<std::unique_ptr<Module>>	modules;
+static std::vector<int>						clients;
+static int									ep;
+static uint32_t								dropped		= 0;
+static uint32_t								rejected	= 0;		// client frames too long, or for a module gone
+
+// the auto baud callback has no module argument, modules are set up one at a time
+static EBYTESerial *configuring = nullptr;
+
+static void SetBaud(uint32_t baud) {
+	if (configuring) {
+		configuring->SetBaud(baud);
+	}
+}
+
+static void Usage() {
+	fprintf(stderr, "usage: ebyte-gatewayd [-s socket] [-g gpiochip] [-b baud] [-t gap ms] [-n simulated] port[:m0,m1,aux] ...\n");
+	exit(2);
+}
+
+static void Watch(int fd, uint32_t events, bool add) {
+
+	struct epoll_event ev;
+
+	ev.events	= events;
+	ev.data.fd	= fd;
+	epoll_ctl(ep, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev);
+}
+
+static bool AddModule(const char *spec, uint32_t baud) {
+
+	std::unique_ptr<Module>	m(new Module);
+	std::string				s(spec);
+	size_t					colon = s.find(':');
+	unsigned int			m0 = 255, m1 = 255, aux = 255;
+
+	m->path = s.substr(0, colon);
+	if ((colon != std::string::npos) && (sscanf(s.c_str() + colon + 1, "%u,%u,%u", &m0, &m1, &aux) != 3)) {
+		fprintf(stderr, "%s: pins are m0,m1,aux\n", spec);
+		return false;
+	}
+	if (!m->port.Open(m->path.c_str(), baud)) {
+		fprintf(stderr, "%s: %s\n", m->path.c_str(), strerror(errno));
+		return false;
+	}
+
+	m->radio.reset(new EBYTE(&m->port, m0, m1, aux));
+
+	configuring = &m->port;
+	if (!m->radio->init(SetBaud)) {
+		fprintf(stderr, "%s: module did not answer\n", m->path.c_str());
+		return false;
+	}
+	configuring = nullptr;
+
+	fprintf(stderr, "module %zu: %s address 0x%04X channel %u air %lu bps%s\n", modules.size(), m->path.c_str(),
+		m->radio->GetAddress(), m->radio->GetChannel(), (unsigned long)m->radio->GetAirDataRateBps(),
+		m->radio->GetTransmissionMode() ? " fixed" : "");
+
+	Watch(m->port.Fd(), EPOLLIN, true);
+	modules.push_back(std::move(m));
+	return true;
+}
+
+static int Listen(const char *path) {
+
+	struct sockaddr_un	addr;
+	int					fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+
+	if ((fd < 0) || (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(fd, 8) != 0)) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	Watch(fd, EPOLLIN, true);
+	return fd;
+}
+
+static void DropClient(int fd) {
+
+	epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	for (size_t i = 0; i < clients.size(); i++) {
+		if (clients[i] == fd) {
+			clients.erase(clients.begin() + i);
+			break;
+		}
+	}
+}
+
+/*
+a frame is complete, hand it to every client
+*/
+static void Publish(uint8_t index, Module &m) {
+
+	uint8_t msg[GW_MAX_FRAME + 1];
+
+	msg[0] = index;
+	memcpy(&msg[1], m.rx, m.rxLen);
+	m.framesIn++;
+
+	for (size_t i = 0; i < clients.size();) {
+		if (send(clients[i], msg, m.rxLen + 1, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+			i++;
+		}
+		else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+			dropped++;
+			i++;
+		}
+		else {
+			DropClient(clients[i]);
+		}
+	}
+	m.rxLen = 0;
+}
+
+/*
+a module that is gone (adapter unplugged, pseudo terminal closed) is taken out of the loop, what it
+still had to send is thrown away
+*/
+static void DropModule(uint8_t index, Module &m) {
+
+	fprintf(stderr, "module %u: %s gone, %zu frames not sent\n", index, m.path.c_str(), m.tx.size());
+	epoll_ctl(ep, EPOLL_CTL_DEL, m.port.Fd(), nullptr);
+	m.port.Close();
+	if (m.rxLen) {
+		Publish(index, m);
+	}
+	m.tx.clear();
+	m.txDone	= 0;
+	m.txWaiting	= false;
+	m.gone		= true;
+}
+
+/*
+method to read what the port has. Back to back sub packets at high air rates come with no gap
+between them, a full buffer is published as a frame and counted. End of file means the module is gone
+*/
+static void ReadModule(uint8_t index, Module &m) {
+
+	uint8_t buf[GW_MAX_FRAME];
+	ssize_t	n;
+
+	while ((n = ::read(m.port.Fd(), buf, sizeof(buf))) != 0) {
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				break;
+			}
+			return;
+		}
+
+		for (ssize_t i = 0; i < n; i++) {
+			if (m.rxLen == GW_MAX_FRAME) {
+				m.overflows++;
+				Publish(index, m);
+			}
+			m.rx[m.rxLen++] = buf[i];
+		}
+		m.rxLast = millis();
+	}
+	// EOF, or a pseudo terminal whose other end closed (EIO)
+	DropModule(index, m);
+}
+
+/*
+method to move the module's send queue on without blocking. A frame starts only when the one
+before has had its UART and airtime and AUX is up, then goes out as far as the port takes it
+*/
+static void WriteModule(Module &m) {
+
+	while (!m.tx.empty()) {
+
+		std::vector<uint8_t> &f = m.tx.front();
+
+		if (m.txDone == 0) {
+			if (((long)(micros() - m.txNext) < 0) || !m.radio->GetAux()) {
+				break;
+			}
+		}
+
+		ssize_t n = write(m.port.Fd(), f.data() + m.txDone, f.size() - m.txDone);
+
+		if (n < 0) {
+			if ((errno == EAGAIN) || (errno == EINTR)) {
+				if (!m.txWaiting) {
+					Watch(m.port.Fd(), EPOLLIN | EPOLLOUT, false);
+					m.txWaiting = true;
+				}
+			}
+			return;
+		}
+		m.txDone += n;
+		if (m.txDone < f.size()) {
+			continue;
+		}
+
+		m.txNext	= micros() + m.radio->UARTTimeMicros(f.size()) + m.radio->AirTimeMicros(f.size());
+		m.txDone	= 0;
+		m.framesOut++;
+		m.tx.pop_front();
+	}
+
+	if (m.txWaiting) {
+		Watch(m.port.Fd(), EPOLLIN, false);
+		m.txWaiting = false;
+	}
+}
+
+static void ReadClient(int fd) {
+
+	uint8_t			msg[GW_MAX_FRAME + 1];
+	struct iovec	iov = { msg, sizeof(msg) };
+	struct msghdr	hdr;
+	ssize_t			n;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov		= &iov;
+	hdr.msg_iovlen	= 1;
+
+	while ((n = recvmsg(fd, &hdr, MSG_DONTWAIT)) > 0) {
+		// a frame cut to fit would go on air cut, it doesn't go at all
+		if ((hdr.msg_flags & MSG_TRUNC) || (msg[0] >= modules.size()) || modules[msg[0]]->gone) {
+			rejected++;
+			continue;
+		}
+		if (n >= 2) {
+			modules[msg[0]]->tx.emplace_back(msg + 1, msg + n);
+		}
+	}
+	if ((n == 0) || ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+		DropClient(fd);
+	}
+}
+
+int main(int argc, char **argv) {
+
+	const char		*socketPath	= "/tmp/ebyte.sock";
+	const char		*chip		= nullptr;
+	uint32_t		baud		= 9600;
+	unsigned long	gap			= 10;
+	int				sims		= 0;
+	int				opt;
+
+	while ((opt = getopt(argc, argv, "s:g:b:t:n:h")) != -1) {
+		switch (opt) {
+		case 's':	socketPath	= optarg;					break;
+		case 'g':	chip		= optarg;					break;
+		case 'b':	baud		= strtoul(optarg, 0, 10);	break;
+		case 't':	gap			= strtoul(optarg, 0, 10);	break;
+		case 'n':	sims		= atoi(optarg);				break;
+		default:	Usage();
+		}
+	}
+	if (((optind == argc) && (sims == 0)) || (sims < 0) || (sims > GW_SIM_MAX) || (chip && sims)) {
+		Usage();
+	}
+
+	// blocked before the simulator thread starts so it inherits the mask, the signalfd gets them
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+	std::unique_ptr<EBYTEGpio>		gpio;
+	EBYTESimAir						air;
+	EBYTESimHost					host(&air);
+	std::vector<std::unique_ptr<EBYTESimModule>>	simModules;
+	std::vector<std::string>		specs(argv + optind, argv + argc);
+
+	if (chip) {
+		EBYTEGpioChip *g = new EBYTEGpioChip(chip);
+		if (!g->Ok()) {
+			fprintf(stderr, "%s: %s\n", chip, strerror(errno));
+			return 1;
+		}
+		gpio.reset(g);
+	}
+	else if (sims) {
+		gpio.reset(new EBYTEGpioSim);
+	}
+	SetGpio(gpio.get());
+
+	// simulated modules go on pseudo terminals, pins 3i, 3i+1, 3i+2 on the simulated GPIO
+	for (int i = 0; i < sims; i++) {
+
+		char spec[96];
+
+		simModules.emplace_back(new EBYTESimModule);
+		air.Add(simModules.back().get());
+		int p = host.Add(simModules.back().get(), gpio.get(), 3 * i, 3 * i + 1, 3 * i + 2);
+		if (p < 0) {
+			fprintf(stderr, "no pseudo terminal: %s\n", strerror(errno));
+			return 1;
+		}
+		snprintf(spec, sizeof(spec), "%s:%d,%d,%d", host.Path(p), 3 * i, 3 * i + 1, 3 * i + 2);
+		specs.push_back(spec);
+	}
+	host.Start();
+
+	ep = epoll_create1(EPOLL_CLOEXEC);
+
+	for (const std::string &spec : specs) {
+		if (!AddModule(spec.c_str(), baud)) {
+			return 1;
+		}
+	}
+
+	int sig		= signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	int server	= Listen(socketPath);
+
+	Watch(sig, EPOLLIN, true);
+	fprintf(stderr, "listening on %s\n", socketPath);
+
+	for (;;) {
+
+		struct epoll_event	events[GW_EVENTS];
+		int					timeout = -1;
+		unsigned long		now		= millis();
+
+		// wake for the end of a frame, and for the next paced write
+		for (auto &m : modules) {
+			if (m->gone) {
+				continue;
+			}
+			if (m->rxLen) {
+				long left = (long)(m->rxLast + gap - now);
+				timeout = ((timeout < 0) || (left < timeout)) ? (left < 0 ? 0 : left) : timeout;
+			}
+			if (!m->tx.empty() && !m->txWaiting) {
+				timeout = ((timeout < 0) || (timeout > 1)) ? 1 : timeout;
+			}
+		}
+
+		int n = epoll_wait(ep, events, GW_EVENTS, timeout);
+
+		for (int i = 0; i < n; i++) {
+
+			int fd = events[i].data.fd;
+
+			if (fd == sig) {
+				goto done;
+			}
+			if (fd == server) {
+				int c;
+				while ((c = accept4(server, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+					clients.push_back(c);
+					Watch(c, EPOLLIN, true);
+				}
+				continue;
+			}
+
+			bool found = false;
+
+			for (size_t j = 0; j < modules.size(); j++) {
+
+				Module &m = *modules[j];
+
+				if (m.gone || (m.port.Fd() != fd)) {
+					continue;
+				}
+				// a hang up is read first, for what was still on its way and the end of file
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+					ReadModule(j, m);
+				}
+				found = true;
+				break;
+			}
+			if (!found) {
+				ReadClient(fd);
+			}
+		}
+
+		now = millis();
+		for (size_t i = 0; i < modules.size(); i++) {
+			if (modules[i]->gone) {
+				continue;
+			}
+			if (modules[i]->rxLen && ((now - modules[i]->rxLast) >= gap)) {
+				Publish(i, *modules[i]);
+			}
+			WriteModule(*modules[i]);
+		}
+	}
+
+done:
+	for (size_t i = 0; i < modules.size(); i++) {
+		fprintf(stderr, "module %zu: %u frames in (%u cut at %u bytes), %u out%s\n", i, modules[i]->framesIn, modules[i]->overflows,
+			GW_MAX_FRAME, modules[i]->framesOut, modules[i]->gone ? ", gone" : "");
+	}
+	fprintf(stderr, "%u frames dropped by slow clients, %u client frames rejected\n", dropped, rejected);
+
+	for (int c : clients) {
+		close(c);
+	}
+	close(server);
+	unlink(socketPath);
+	host.Stop();
+	return 0;
+}
@@ -0,0 +1,283 @@
+/*
+  ebyte-netsim: many sensors and one gateway on a simulated channel, hours of traffic in seconds
+
+  Node 0 is the gateway, in the middle of a square field; the others are sensors placed at random in
+  it. Every sensor runs the library as a sketch would: init(), set its address, air rate and fixed mode
+  (SaveParameters), then send a reading to the gateway every interval, give or take 10%. The gateway
+  reads them with GetStruct(). All of it runs on EBYTESimNetwork's virtual clock, see EBYTE_SimNet.h.
+
+  A reading carries the sensor, a sequence number and the millis() it was made at, so the gateway
+  measures the latency the application sees; the network measures frames (sent, delivered, collided,
+  too weak) and the latency from the first byte written to the module to the end of the packet.
+
+  usage: ebyte-netsim [-n nodes] [-t seconds] [-i interval s] [-p report s] [-b bytes] [-a air rate]
+					[-s field m] [-e seed] [-l] [-c] [-w]
+
+	-l	sensors turn on the module's LBT
+	-c	sensors send through EBYTECsma (ambient RSSI, random backoff) instead of SendStruct()
+	-w	sensors send in WOR transmit mode (500 ms preamble), the gateway listens in WOR receive
+
+	ebyte-netsim -n 500 -t 3600					500 nodes for an hour, reports every minute
+	ebyte-netsim -n 500 -t 3600 -a 5 -c			the same at 19.2k air rate with software CSMA
+*/
+
+#include "EBYTE_E220.h"
+#include "EBYTE_CSMA.h"
+#include "EBYTE_SimNet.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#define NETSIM_CHANNEL		18
+#define NETSIM_GATEWAY		0x0000
+#define NETSIM_HEADER		3			// fixed mode address and channel
+#define NETSIM_MAX_BYTES	(200 - NETSIM_HEADER)
+
+// what a sensor sends, padded to the bytes asked for
+struct Reading {
+	uint16_t	from;
+	uint16_t	seq;
+	uint32_t	made;		// millis() of the sensor
+} __attribute__((packed));
+
+struct Sensor {
+	unsigned long	next	= 0;		// millis() the next reading is due
+	uint16_t		seq		= 0;
+	EBYTECsmaBase	*mac	= nullptr;
+};
+
+static uint8_t					airRate			= ADR_2400;
+static uint8_t					readingBytes	= 16;
+static unsigned long			intervalMs		= 60000;
+static bool						lbt				= false;
+static bool						csma			= false;
+static bool						wor				= false;
+
+static uint32_t					initFailures	= 0;
+static uint32_t					readingsSent	= 0;
+static uint32_t					readingsIn		= 0;
+static uint32_t					readingsShort	= 0;
+static uint64_t					bytesIn			= 0;
+static std::vector<uint32_t>	appLatency;			// ms, made to read at the gateway
+
+static void Usage() {
+	fprintf(stderr, "usage: ebyte-netsim [-n nodes] [-t seconds] [-i interval s] [-p report s] [-b bytes] [-a air rate]\n"
+					"                    [-s field m] [-e seed] [-l] [-c] [-w]\n");
+	exit(2);
+}
+
+static uint32_t Percentile(std::vector<uint32_t> v, float percentile) {
+
+	size_t i;
+
+	if (v.empty()) {
+		return 0;
+	}
+	i = std::min(v.size() - 1, (size_t)(percentile / 100.0 * v.size()));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+/*
+the registers every node shares, written to the module for as long as it is powered
+*/
+static void Configure(EBYTE &radio, uint16_t address) {
+
+	if (!radio.init()) {
+		initFailures++;
+	}
+	radio.SetAddress(address);
+	radio.SetChannel(NETSIM_CHANNEL);
+	radio.SetAirDataRate(airRate);
+	radio.SetTransmissionMode(FixedModeENABLE);
+	radio.SetWORTIming(OPT_WAKEUP500);
+}
+
+static void GatewaySetup(EBYTESimNode *node) {
+
+	Configure(node->Radio, NETSIM_GATEWAY);
+	node->Radio.SetEnableRSSIByte(true);
+	node->Radio.SaveParameters(TEMPORARY);
+	if (wor) {
+		node->Radio.SetMode(MODE_WORreceive);
+	}
+}
+
+static void GatewayLoop(EBYTESimNode *node) {
+
+	uint8_t frame[NETSIM_MAX_BYTES];
+	Reading	r;
+
+	while (node->Radio.available()) {
+		if (!node->Radio.GetStruct(frame, readingBytes)) {
+			readingsShort++;
+			continue;
+		}
+		memcpy(&r, frame, sizeof(r));
+		readingsIn++;
+		bytesIn += readingBytes;
+		appLatency.push_back(millis() - r.made);
+	}
+	node->Wait(1000);
+}
+
+static void SensorSetup(EBYTESimNode *node) {
+
+	Sensor *s = (Sensor *)node->Data;
+
+	Configure(node->Radio, node->Index);
+	node->Radio.SetEnableLBT(lbt);
+	node->Radio.SetRSSIAmbientNoiseEnable(csma);
+	node->Radio.SaveParameters(TEMPORARY);
+	if (wor) {
+		node->Radio.SetMode(MODE_WORtransmit);
+	}
+	if (csma) {
+		s->mac = new EBYTECsma<>(&node->Radio);
+	}
+	s->next = millis() + random(intervalMs);
+}
+
+static void SensorLoop(EBYTESimNode *node) {
+
+	Sensor	*s = (Sensor *)node->Data;
+	uint8_t	frame[NETSIM_HEADER + NETSIM_MAX_BYTES];
+	long	wait;
+
+	if (s->mac) {
+		s->mac->Poll();
+	}
+	if (((long)(millis() - s->next) >= 0) && (!s->mac || !s->mac->Pending())) {
+
+		Reading r = { node->Index, s->seq++, (uint32_t)millis() };
+
+		memset(frame, 0, sizeof(frame));
+		frame[0] = NETSIM_GATEWAY >> 8;
+		frame[1] = NETSIM_GATEWAY & 0xFF;
+		frame[2] = NETSIM_CHANNEL;
+		memcpy(&frame[NETSIM_HEADER], &r, sizeof(r));
+
+		if (s->mac) {
+			s->mac->Send(frame, NETSIM_HEADER + readingBytes);
+		}
+		else {
+			node->Radio.SendStruct(frame, NETSIM_HEADER + readingBytes);
+		}
+		readingsSent++;
+		s->next += intervalMs - (intervalMs / 10) + random(intervalMs / 5);
+	}
+
+	wait = (long)(s->next - millis());
+	if (s->mac && s->mac->Pending()) {
+		// backing off is counted in slots of a full sub packet, looked at ten times a slot
+		wait = (s->mac->State() == CSMA_BACKOFF) ? (node->Radio.AirTimeMicros(node->Radio.GetSubPacketBytes()) / 10000) : 1;
+	}
+	node->Wait((wait > 0) ? wait : 0);
+}
+
+int main(int argc, char **argv) {
+
+	EBYTESimNetwork		net;
+	unsigned int		nodes		= 500;
+	unsigned long		seconds		= 3600;
+	unsigned long		period		= 60;
+	float				field		= 2000;
+	uint32_t			seed		= 1;
+	struct timespec		t0, t1;
+	int					opt;
+
+	while ((opt = getopt(argc, argv, "n:t:i:p:b:a:s:e:lcwh")) != -1) {
+		switch (opt) {
+		case 'n':	nodes			= strtoul(optarg, 0, 10);			break;
+		case 't':	seconds			= strtoul(optarg, 0, 10);			break;
+		case 'i':	intervalMs		= strtoul(optarg, 0, 10) * 1000;	break;
+		case 'p':	period			= strtoul(optarg, 0, 10);			break;
+		case 'b':	readingBytes	= strtoul(optarg, 0, 10);			break;
+		case 'a':	airRate			= strtoul(optarg, 0, 10);			break;
+		case 's':	field			= strtof(optarg, 0);				break;
+		case 'e':	seed			= strtoul(optarg, 0, 10);			break;
+		case 'l':	lbt				= true;								break;
+		case 'c':	csma			= true;								break;
+		case 'w':	wor				= true;								break;
+		default:	Usage();
+		}
+	}
+	if ((optind != argc) || (nodes < 2) || (nodes > 65535) || (period == 0) || (intervalMs < 1000) || (airRate > 7) ||
+		(readingBytes < sizeof(Reading)) || (readingBytes > NETSIM_MAX_BYTES)) {
+		Usage();
+	}
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+
+	std::vector<Sensor> sensors(nodes);
+
+	randomSeed(seed);
+	net.Seed = seed;
+	net.Add(0, 0, GatewaySetup, GatewayLoop);
+	for (unsigned int i = 1; i < nodes; i++) {
+		float x = (random(10000) / 10000.0 - 0.5) * field;
+		float y = (random(10000) / 10000.0 - 0.5) * field;
+		net.Add(x, y, SensorSetup, SensorLoop, &sensors[i]);
+	}
+
+	printf("%u nodes in %.0f m square, %lu s interval, %u bytes, air rate %u%s%s%s\n", nodes, field, intervalMs / 1000, readingBytes,
+		airRate, lbt ? ", LBT" : "", csma ? ", CSMA" : "", wor ? ", WOR" : "");
+	printf("%8s %8s %10s %9s %6s %9s %8s %8s %8s %6s\n", "s", "frames", "delivered", "collided", "weak", "bytes/s", "p50 ms",
+		"p90 ms", "p99 ms", "busy");
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	for (unsigned long done = 0; done < seconds; done += period) {
+
+		unsigned long	step		= std::min(period, seconds - done);
+		uint32_t		sent		= net.Sent;
+		uint32_t		delivered	= net.Delivered;
+		uint32_t		collided	= net.Collided;
+		uint32_t		weak		= net.Weak;
+		uint64_t		bytes		= bytesIn;
+		size_t			first		= appLatency.size();
+
+		net.Run((uint64_t)step * 1000000ULL);
+
+		std::vector<uint32_t> latency(appLatency.begin() + first, appLatency.end());
+
+		printf("%8lu %8lu %10lu %9lu %6lu %9.1f %8lu %8lu %8lu %5.1f%%\n", done + step, (unsigned long)(net.Sent - sent),
+			(unsigned long)(net.Delivered - delivered), (unsigned long)(net.Collided - collided), (unsigned long)(net.Weak - weak),
+			(double)(bytesIn - bytes) / step, (unsigned long)Percentile(latency, 50), (unsigned long)Percentile(latency, 90),
+			(unsigned long)Percentile(latency, 99), net.Occupancy(NETSIM_CHANNEL) * 100.0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	double		wall		= (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	uint32_t	deferred	= 0;
+	uint32_t	busy		= 0;
+	uint32_t	dropped		= 0;
+	uint32_t	heard		= net.Delivered + net.Collided + net.Weak;
+
+	for (unsigned int i = 1; i < nodes; i++) {
+		deferred += net.Node(i)->Module.Deferred;
+		if (sensors[i].mac) {
+			busy	+= sensors[i].mac->ChannelBusy;
+			dropped	+= sensors[i].mac->Dropped;
+		}
+	}
+
+	printf("\n%lu s simulated in %.2f s (%.0fx real time), %lu events\n", seconds, wall, wall ? seconds / wall : 0.0,
+		(unsigned long)net.Events);
+	printf("readings: %lu sent, %lu received (%.1f%%), %lu short, %.1f bytes/s, latency p50 %lu p90 %lu p99 %lu ms\n",
+		(unsigned long)readingsSent, (unsigned long)readingsIn, readingsSent ? readingsIn * 100.0 / readingsSent : 0.0,
+		(unsigned long)readingsShort, (double)bytesIn / seconds, (unsigned long)Percentile(appLatency, 50),
+		(unsigned long)Percentile(appLatency, 90), (unsigned long)Percentile(appLatency, 99));
+	printf("frames: %lu sent, %lu delivered, %lu collided (%.1f%%), %lu too weak, air latency p50 %lu p99 %lu ms\n",
+		(unsigned long)net.Sent, (unsigned long)net.Delivered, (unsigned long)net.Collided, heard ? net.Collided * 100.0 / heard : 0.0,
+		(unsigned long)net.Weak, (unsigned long)net.Latency(50) / 1000, (unsigned long)net.Latency(99) / 1000);
+	printf("channel %u busy %.1f%%, %lu LBT deferrals, %lu CSMA busy readings, %lu dropped, %lu init failures\n", NETSIM_CHANNEL,
+		net.Occupancy(NETSIM_CHANNEL) * 100.0, (unsigned long)deferred, (unsigned long)busy, (unsigned long)dropped,
+		(unsigned long)initFailures);
+
+	return 0;
+}
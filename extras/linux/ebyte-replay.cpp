@@ -0,0 +1,258 @@
+/*
+  ebyte-replay: record a session with a module, then replay it without one
+
+  The session is the same both ways: init() the module, then for the given time print every 16 byte
+  frame that comes in with the ms it was read at, and send one back each second. Recording runs it
+  against a module through EBYTECapture and writes the capture; replaying runs it against the capture
+  on a virtual clock (EBYTEReplay) and reports how the library's writes compared to the captured ones.
+
+  A replay of an unchanged library prints what the recording printed, give or take a ms, with no
+  mismatches, in a few ms. Run a capture through a changed library to see whether it still behaves,
+  and how its timing moved (skew). Field captures made with EBYTECapture replay the same way with a session of their own.
+
+  usage: ebyte-replay [-g gpiochip] [-d seconds] -r port[:m0,m1,aux] capture	record from a module
+	ebyte-replay [-d seconds] -n capture							record from a simulated module
+	ebyte-replay [-t tick us] capture								replay
+
+  The simulated module has a simulated peer sending it a frame every 200 ms.
+*/
+
+#include "EBYTE_E220.h"
+#include "EBYTE_Capture.h"
+#include "EBYTE_Linux.h"
+#include "EBYTE_Replay.h"
+#include "EBYTE_Sim.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <memory>
+#include <string>
+
+#define REPLAY_FRAME		16
+#define REPLAY_PEER_MS		200
+#define REPLAY_ANSWER_MS	1000
+#define REPLAY_MARGIN_MS	10000		// a replay that goes wrong stops this long after the capture ends
+
+// the capture goes to a file
+class FilePrint : public Print {
+
+public:
+
+	FilePrint(FILE *f) : _f(f) {}
+
+	size_t	write(uint8_t c)							{ return fwrite(&c, 1, 1, _f); }
+	size_t	write(const uint8_t *buffer, size_t size)	{ return fwrite(buffer, 1, size, _f); }
+	using	Print::write;
+
+private:
+
+	FILE	*_f;
+
+};
+
+static EBYTESerial	port;
+static EBYTESerial	peer;
+static unsigned long	peerNext	= 0;
+static uint16_t		peerCount	= 0;
+static EBYTEReplay	*replaying	= nullptr;
+
+static void Usage() {
+	fprintf(stderr, "usage: ebyte-replay [-g gpiochip] [-d seconds] -r port[:m0,m1,aux] capture\n"
+					"       ebyte-replay [-d seconds] -n capture\n"
+					"       ebyte-replay [-t tick us] capture\n");
+	exit(2);
+}
+
+static void SetBaud(uint32_t baud) {
+	port.SetBaud(baud);
+}
+
+/*
+the simulated peer: a numbered frame every REPLAY_PEER_MS, what the module sends it thrown away
+*/
+static bool Peer() {
+
+	char frame[REPLAY_FRAME + 1];
+
+	while (peer.read() >= 0) {
+	}
+	if ((long)(millis() - peerNext) >= 0) {
+		peerNext += REPLAY_PEER_MS;
+		snprintf(frame, sizeof(frame), "peer frame %5u", peerCount++);
+		peer.write((const uint8_t *)frame, REPLAY_FRAME);
+	}
+	return true;
+}
+
+// a replay runs until everything captured has been played
+static bool Replaying() {
+	return !replaying->Done();
+}
+
+/*
+what is recorded and replayed, output must not depend on anything but what the module does. Runs for
+ms or until poll returns false
+*/
+static void Session(EBYTE &radio, unsigned long ms, bool (*poll)(), EBYTE::ebyteCallbackFunc baud) {
+
+	unsigned long	start	= millis();
+	unsigned long	answer	= REPLAY_ANSWER_MS;
+	uint8_t			frame[REPLAY_FRAME];
+	uint16_t		count	= 0;
+
+	if (!radio.init(baud)) {
+		printf("%6lu init failed\n", millis() - start);
+		return;
+	}
+	printf("%6lu init: address 0x%04X channel %u air %lu bps\n", millis() - start, radio.GetAddress(),
+		radio.GetChannel(), (unsigned long)radio.GetAirDataRateBps());
+
+	while (((millis() - start) < ms) && (!poll || poll())) {
+
+		if (radio.available()) {
+			bool ok = radio.GetStruct(frame, sizeof(frame));
+			printf("%6lu %s %.*s\n", millis() - start, ok ? "frame" : "short", (int)sizeof(frame), (const char *)frame);
+		}
+		if ((millis() - start) >= answer) {
+			char reply[REPLAY_FRAME + 1];
+			snprintf(reply, sizeof(reply), "answer %9u", count++);
+			radio.SendStruct(reply, REPLAY_FRAME);
+			printf("%6lu sent %s\n", millis() - start, reply);
+			answer += REPLAY_ANSWER_MS;
+		}
+		delay(1);
+	}
+}
+
+static int Record(const char *spec, const char *chip, bool sim, unsigned long seconds, const char *path) {
+
+	std::unique_ptr<EBYTEGpio>	gpio;
+	EBYTESimAir					air;
+	EBYTESimHost				host(&air);
+	EBYTESimModule				module(&air), other(&air);
+	std::string					s(spec ? spec : "");
+	size_t						colon = s.find(':');
+	unsigned int				m0 = 255, m1 = 255, aux = 255;
+	FILE						*f = fopen(path, "wb");
+
+	if (!f) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	if (sim) {
+		gpio.reset(new EBYTEGpioSim);
+		air.Add(&module);
+		air.Add(&other);
+		host.Add(&module, gpio.get(), 0, 1, 2);
+		host.Add(&other, gpio.get(), 3, 4, 5);
+		// the peer stays in normal mode
+		gpio->Write(3, LOW);
+		gpio->Write(4, LOW);
+		s	= host.Path(0);
+		m0	= 0;
+		m1	= 1;
+		aux	= 2;
+		if (!peer.Open(host.Path(1))) {
+			fprintf(stderr, "%s: %s\n", host.Path(1), strerror(errno));
+			return 1;
+		}
+		host.Start();
+	}
+	else {
+		if ((colon != std::string::npos) && (sscanf(s.c_str() + colon + 1, "%u,%u,%u", &m0, &m1, &aux) != 3)) {
+			fprintf(stderr, "%s: pins are m0,m1,aux\n", spec);
+			return 1;
+		}
+		s = s.substr(0, colon);
+		if (chip) {
+			EBYTEGpioChip *g = new EBYTEGpioChip(chip);
+			if (!g->Ok()) {
+				fprintf(stderr, "%s: %s\n", chip, strerror(errno));
+				return 1;
+			}
+			gpio.reset(g);
+		}
+	}
+	SetGpio(gpio.get());
+
+	if (!port.Open(s.c_str())) {
+		fprintf(stderr, "%s: %s\n", s.c_str(), strerror(errno));
+		return 1;
+	}
+
+	FilePrint			log(f);
+	EBYTECapture<255>	capture(&port, m0, m1, aux);
+	EBYTE				radio(&capture, m0, m1, aux);
+
+	capture.Begin(&log);
+	peerNext = millis() + REPLAY_PEER_MS;
+	Session(radio, seconds * 1000, sim ? Peer : nullptr, SetBaud);
+	capture.End();
+	fclose(f);
+
+	host.Stop();
+	fprintf(stderr, "captured %lu bytes in, %lu out, %lu pin changes in %lu bytes of log\n", (unsigned long)capture.BytesIn,
+		(unsigned long)capture.BytesOut, (unsigned long)capture.Transitions, (unsigned long)capture.LogBytes);
+	return 0;
+}
+
+static int Replay(const char *path, uint32_t tick) {
+
+	EBYTEReplay		replay;
+	struct timespec	t0, t1;
+
+	if (!replay.Open(path)) {
+		fprintf(stderr, "%s: not a capture\n", path);
+		return 1;
+	}
+
+	EBYTE radio(&replay, replay.PinM0(), replay.PinM1(), replay.PinAUX());
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	replaying	= &replay;
+	replay.Tick	= tick;
+	replay.Begin();
+	Session(radio, (replay.Length() / 1000) + REPLAY_MARGIN_MS, Replaying, nullptr);
+	replay.End();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	fprintf(stderr, "replayed %.3f s in %.1f ms: %s, %lu bytes in, %lu out, %lu mismatches, %lu pin mismatches, max skew %lu us\n",
+		replay.Now() / 1e6, (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6,
+		replay.Done() ? "complete" : "incomplete", (unsigned long)replay.BytesIn, (unsigned long)replay.BytesOut,
+		(unsigned long)replay.Mismatches, (unsigned long)replay.PinMismatches, (unsigned long)replay.MaxSkew);
+	return (replay.Done() && (replay.Mismatches == 0) && (replay.PinMismatches == 0)) ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+
+	const char		*spec		= nullptr;
+	const char		*chip		= nullptr;
+	bool			sim			= false;
+	unsigned long	seconds		= 5;
+	uint32_t		tick		= 1;
+	int				opt;
+
+	while ((opt = getopt(argc, argv, "r:g:nd:t:h")) != -1) {
+		switch (opt) {
+		case 'r':	spec	= optarg;					break;
+		case 'g':	chip	= optarg;					break;
+		case 'n':	sim		= true;						break;
+		case 'd':	seconds	= strtoul(optarg, 0, 10);	break;
+		case 't':	tick	= strtoul(optarg, 0, 10);	break;
+		default:	Usage();
+		}
+	}
+	if ((optind != argc - 1) || (spec && sim) || (chip && !spec)) {
+		Usage();
+	}
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+
+	if (spec || sim) {
+		return Record(spec, chip, sim, seconds, argv[optind]);
+	}
+	return Replay(argv[optind], tick);
+}